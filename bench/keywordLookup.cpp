@@ -0,0 +1,137 @@
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Tokenizer.hpp"
+
+// classifies the same identifier-heavy word list with the compare chain the tokenizer used to have
+// and with the perfect hash, build with -DWHACKY_BENCH=ON and run keywordLookupBench
+
+namespace {
+    constexpr size_t wordCount = 4'000'000;
+    constexpr int runs = 5;
+
+    std::optional<TokenType> chainLookup(const std::string_view buf) {
+        if (buf == "bye") {
+            return TokenType::bye;
+        } else if (buf == "yell") {
+            return TokenType::yell;
+        } else if (buf == "gimme") {
+            return TokenType::gimme;
+        } else if (buf == "yep") {
+            return TokenType::_bool;
+        } else if (buf == "nope") {
+            return TokenType::_bool;
+        } else if (buf == "thingy") {
+            return TokenType::thingy;
+        } else if (buf == "gimmeback") {
+            return TokenType::gimmeback;
+        } else if (buf == "four") {
+            return TokenType::four;
+        } else if (buf == "in") {
+            return TokenType::in;
+        } else if (buf == "why") {
+            return TokenType::why;
+        } else if (buf == "maybe") {
+            return TokenType::maybe;
+        } else if (buf == "but") {
+            return TokenType::but;
+        } else if (buf == "nah") {
+            return TokenType::nah;
+        } else if (buf == "and") {
+            return TokenType::_and;
+        } else if (buf == "or") {
+            return TokenType::_or;
+        } else if (buf == "band") {
+            return TokenType::band;
+        } else if (buf == "bor") {
+            return TokenType::bor;
+        } else if (buf == "xor") {
+            return TokenType::_xor;
+        } else if (buf == "number") {
+            return TokenType::type_number;
+        } else if (buf == "str") {
+            return TokenType::type_string;
+        } else if (buf == "bool") {
+            return TokenType::type_bool;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<TokenType> hashLookup(const std::string_view buf) {
+        if (const Keyword* keyword = findKeyword(buf)) {
+            return keyword->type;
+        }
+        return std::nullopt;
+    }
+
+    // one word in five is a keyword, the rest are identifiers of 1 to 12 characters, all in one buffer like
+    // the source the tokenizer slices them from
+    std::string makeSource(std::vector<std::pair<size_t, size_t>>& spans) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> pick(0, keywordList.size() - 1);
+        std::uniform_int_distribution<size_t> length(1, 12);
+        std::uniform_int_distribution<int> letter('a', 'z');
+        std::string source;
+        for (size_t i = 0; i < wordCount; i++) {
+            const size_t start = source.size();
+            if (i % 5 == 0) {
+                source += keywordList[pick(rng)].spelling;
+            } else {
+                for (size_t n = length(rng); n > 0; n--) {
+                    source.push_back(static_cast<char>(letter(rng)));
+                }
+            }
+            spans.emplace_back(start, source.size() - start);
+            source.push_back(' ');
+        }
+        return source;
+    }
+
+    template<typename Lookup>
+    double bestOf(const std::vector<std::string_view>& words, const Lookup lookup, size_t& keywordsFound) {
+        double best = 0;
+        for (int run = 0; run < runs; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            size_t found = 0;
+            for (const std::string_view word : words) {
+                found += lookup(word).has_value();
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (run == 0 || elapsed.count() < best) {
+                best = elapsed.count();
+            }
+            keywordsFound = found;
+        }
+        return best;
+    }
+}
+
+int main() {
+    std::vector<std::pair<size_t, size_t>> spans;
+    const std::string source = makeSource(spans);
+    std::vector<std::string_view> words;
+    for (const auto& [start, size] : spans) {
+        words.push_back(std::string_view(source).substr(start, size));
+    }
+
+    for (const std::string_view word : words) {
+        if (chainLookup(word) != hashLookup(word)) {
+            std::cerr << "[Bench Error] lookups disagree on '" << word << "'" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t chainFound = 0;
+    size_t hashFound = 0;
+    const double chain = bestOf(words, chainLookup, chainFound);
+    const double hash = bestOf(words, hashLookup, hashFound);
+    std::cout << words.size() << " words, " << hashFound << " keywords, best of " << runs << " runs" << std::endl;
+    std::cout << "  compare chain  " << chain << " ms" << std::endl;
+    std::cout << "  perfect hash   " << hash << " ms" << std::endl;
+    return chainFound == hashFound ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <sstream>
+#include "MachineIR.hpp"
+
+// renders an allocated module as nasm source
+class AsmPrinter {
+public:
+    explicit AsmPrinter(const MModule& module);
+
+    std::string print();
+
+private:
+    void printData(const MData& data);
+    void printFunction(const MFunction& function);
+    void printInst(const MInst& inst);
+    std::string operand(const Operand& operand) const;
+    std::string address(const Operand& operand) const;
+    std::string reg8(const Operand& operand) const;
+private:
+    const MModule& m_Module;
+    std::stringstream m_Output;
+};
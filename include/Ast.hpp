@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Tokenizer.hpp"
+
+enum class BinOp {
+    Or, And, Band, Bor, Xor, Neq, Eq, Ge, Gt, Le, Lt, Add, Sub, Mul, Div
+};
+
+inline std::optional<BinOp> tokenTypeToBinOp(const TokenType type) {
+    switch (type) {
+        case TokenType::_or: return BinOp::Or;
+        case TokenType::_and: return BinOp::And;
+        case TokenType::band: return BinOp::Band;
+        case TokenType::bor: return BinOp::Bor;
+        case TokenType::_xor: return BinOp::Xor;
+        case TokenType::neq: return BinOp::Neq;
+        case TokenType::eqeq: return BinOp::Eq;
+        case TokenType::ge: return BinOp::Ge;
+        case TokenType::gt: return BinOp::Gt;
+        case TokenType::le: return BinOp::Le;
+        case TokenType::lt: return BinOp::Lt;
+        case TokenType::plus: return BinOp::Add;
+        case TokenType::minus: return BinOp::Sub;
+        case TokenType::star: return BinOp::Mul;
+        case TokenType::fslash: return BinOp::Div;
+        default: return {};
+    }
+}
+
+using NodeIndex = uint32_t;
+
+// node 0 is always the program root, which is never anyone's child, so 0 doubles as "no node"
+inline constexpr NodeIndex NoNode = 0;
+
+// meaning of the main slot and the two data slots per kind;
+// "extra" indexes Ast::m_Extra, ranges are [lhs, rhs)
+enum class NodeKind : uint8_t {
+    Prog,       // lhs..rhs: statements
+    IntLit,     // lhs, rhs: low and high half of the value
+    Bool,       // lhs: 0 or 1
+    String,     // main: index of the literal contents
+    Ident,      // main: name
+    Call,       // main: name, lhs..rhs: arguments
+    BinExpr,    // main: BinOp, lhs: left, rhs: right
+    Scope,      // lhs..rhs: statements
+    Bye,        // lhs: expr
+    Gimme,      // main: name, lhs: expr, rhs: declared TokenType
+    Assignment, // main: name, lhs: expr
+    Maybe,      // lhs: condition, rhs: extra -> { scope, pred or NoNode }
+    But,        // same layout as Maybe
+    Nah,        // lhs: scope
+    Yell,       // lhs: expr
+    Thingy,     // main: name, lhs: extra -> { params begin, params end, return TokenType }, rhs: scope
+    Param,      // main: name, rhs: TokenType
+    Gimmeback,  // lhs: expr
+    Four,       // main: loop variable, lhs: extra -> { start, end }, rhs: scope
+    Why,        // lhs: condition, rhs: scope
+};
+
+struct NodeData {
+    uint32_t lhs = 0;
+    uint32_t rhs = 0;
+};
+
+// flat struct-of-arrays syntax tree: nodes are 32-bit indices into parallel columns,
+// child lists and multi-field payloads live in one shared extra array.
+// tokens are not kept, names are interned ids and string literals are views into the source
+class Ast {
+public:
+    struct Branch {
+        NodeIndex cond;
+        NodeIndex scope;
+        NodeIndex pred;
+    };
+
+    struct Loop {
+        NodeIndex start;
+        NodeIndex end;
+        NodeIndex scope;
+    };
+
+    struct Proto {
+        std::span<const NodeIndex> params;
+        TokenType returnType;
+        NodeIndex scope;
+    };
+
+    NodeKind kind(const NodeIndex node) const { return m_Kinds[node]; }
+    NodeIndex lhs(const NodeIndex node) const { return m_Data[node].lhs; }
+    NodeIndex rhs(const NodeIndex node) const { return m_Data[node].rhs; }
+    NameId name(const NodeIndex node) const { return m_Main[node]; }
+    std::string_view string(const NodeIndex node) const { return m_Strings[m_Main[node]]; }
+
+    std::span<const NodeIndex> list(const NodeIndex node) const {
+        return std::span(m_Extra).subspan(m_Data[node].lhs, m_Data[node].rhs - m_Data[node].lhs);
+    }
+    BinOp binOp(const NodeIndex node) const { return static_cast<BinOp>(m_Main[node]); }
+    uint64_t intValue(const NodeIndex node) const {
+        return static_cast<uint64_t>(m_Data[node].rhs) << 32 | m_Data[node].lhs;
+    }
+    // declared type of a Gimme or Param
+    TokenType typeToken(const NodeIndex node) const { return static_cast<TokenType>(m_Data[node].rhs); }
+    Branch branch(const NodeIndex node) const;
+    Loop loop(const NodeIndex node) const;
+    Proto proto(const NodeIndex node) const;
+
+    NodeIndex root() const { return 0; }
+    size_t nodeCount() const { return m_Kinds.size(); }
+
+    NodeIndex addNode(NodeKind kind, uint32_t main = 0, NodeData data = {});
+    void setData(NodeIndex node, NodeData data) { m_Data[node] = data; }
+    uint32_t addString(std::string_view value);
+    uint32_t addExtra(std::span<const uint32_t> values); // returns the start index
+private:
+    std::vector<NodeKind> m_Kinds;
+    std::vector<uint32_t> m_Main;
+    std::vector<NodeData> m_Data;
+    std::vector<uint32_t> m_Extra;
+    std::vector<std::string_view> m_Strings;
+};
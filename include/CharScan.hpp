@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// byte-run scanners used by the tokenizer, picked at startup from scalar, SSE2 and AVX2 versions
+namespace scan {
+    // ascii classification, independent of the C locale
+    constexpr bool isSpace(const char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+    constexpr bool isDigit(const char c) { return c >= '0' && c <= '9'; }
+    constexpr bool isAlpha(const char c) { return (c | 0x20) >= 'a' && (c | 0x20) <= 'z'; }
+    constexpr bool isAlnum(const char c) { return isAlpha(c) || isDigit(c); }
+
+    enum class Level {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    struct NewlineCount {
+        size_t count = 0;
+        const char* last = nullptr; // last '\n' in the range, nullptr if there is none
+    };
+
+    // each returns the first position in [p, end) that stops the run, or end
+    const char* skipWhitespace(const char* p, const char* end);
+    const char* skipAlnum(const char* p, const char* end);
+    const char* skipDigits(const char* p, const char* end);
+    const char* findChar(const char* p, const char* end, char c);
+    const char* findCommentEnd(const char* p, const char* end); // points at the '*' of "*/"
+
+    NewlineCount countNewlines(const char* p, const char* end);
+
+    Level level();
+    const char* levelName(Level level);
+}
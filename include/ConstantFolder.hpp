@@ -0,0 +1,40 @@
+#pragma once
+
+#include <optional>
+#include "IR.hpp"
+
+// evaluates instructions whose operands are all known at compile time and replaces them with constants,
+// string concatenation and repetition included. only registers with a single definition are tracked,
+// that covers every temporary and each variable that is never reassigned after its gimme, so a constant
+// stored in such a variable reaches all of its uses. constants nothing reads anymore are dropped
+class ConstantFolder {
+public:
+    explicit ConstantFolder(IRModule& module);
+
+    void run();
+
+private:
+    struct Known {
+        enum class Kind : uint8_t { None, Int, Str };
+        Kind kind = Kind::None;
+        int64_t value = 0; // the number, or the string index for Str
+    };
+
+    void foldFunction(IRFunction& function);
+    // appends the folded replacement of inst to out, returns false if it has to stay as it is
+    bool fold(const IRInst& inst, std::vector<IRInst>& out);
+    bool foldRuntimeCall(const IRInst& inst, std::vector<IRInst>& out);
+    static std::optional<int64_t> foldBinary(IROp op, int64_t a, int64_t b);
+    static bool compare(CmpOp cmp, int64_t a, int64_t b);
+    // the first len bytes a string register pair points at, if they lie within its literal
+    std::optional<std::string> stringBytes(VReg ptr, VReg len) const;
+    void removeUnusedConstants(IRFunction& function);
+
+    const Known& known(const VReg reg) const { return m_Known[reg]; }
+    std::optional<int64_t> knownInt(VReg reg) const;
+private:
+    IRModule& m_Module;
+    const IRFunction* m_Function = nullptr;
+    std::vector<Known> m_Known; // indexed by VReg
+    std::vector<uint32_t> m_DefCount; // indexed by VReg
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "IR.hpp"
+
+// removes code that cannot affect the program: branches on constants become jumps, blocks no path
+// reaches are dropped, stores overwritten or never read before the variable dies go away, and so does
+// every computation whose result ends up unused
+class DeadCodeEliminator {
+public:
+    explicit DeadCodeEliminator(IRModule& module);
+
+    void run();
+
+private:
+    struct InstRef {
+        uint32_t block;
+        uint32_t index;
+    };
+
+    void foldBranches();
+    void removeUnreachable();
+    // liveness of reassigned registers decides which of their definitions are dead
+    bool removeDeadStores();
+    // mark and sweep from the instructions with side effects
+    bool removeUnused();
+    bool hasSideEffects(const IRInst& inst) const;
+    void countDefs();
+private:
+    IRModule& m_Module;
+    IRFunction* m_Function = nullptr;
+    std::vector<uint32_t> m_DefCount; // indexed by VReg
+    std::vector<const IRInst*> m_SingleDef; // the definition of registers written exactly once
+};
@@ -1,52 +1,58 @@
 #pragma once
 
+#include "IR.hpp"
 #include "Parser.hpp"
 #include "TypeChecker.hpp"
 #include "OperationGenerator.hpp"
 
+// lowers the annotated tree into IR, one function per thingy plus _start for the top-level statements
 class Generator {
 public:
-    Generator(NodeProg prog);
-    
-    void generateTerm(const NodeTerm* term);
-    void generateExpr(const NodeExpr* expr);
-    void generateBinExpr(const NodeBinExpr* binExpr);
-    void generateScope(const NodeScope* scope);
-    void generateMaybePred(const NodeMaybePred* pred, const std::string& endLabel);
-    void generateThingy(const NodeStmtThingy* stmtThingy);
-    void generateStmt(const NodeStmt* stmt);
-    std::string generateProg();
-    
+    Generator(const Ast& ast, const Interner& interner, const Annotations& annotations);
+
+    Value generateTerm(NodeIndex term);
+    Value generateExpr(NodeIndex expr);
+    Value generateBinExpr(NodeIndex binExpr);
+    void generateScope(NodeIndex scope);
+    void generateMaybePred(NodeIndex pred, uint32_t endBlock);
+    void generateThingy(NodeIndex stmtThingy);
+    void generateStmt(NodeIndex stmt);
+    IRModule generateProg();
+
 private:
-    void push(const std::string& reg, size_t size = 8);
-    void pop(const std::string& reg, size_t size = 8);
-    
-    void enterScope();
-    void leaveScope();
-    
-    void declareVar(const std::string& name, VarType type);
-    void declareParam(const std::string& name, VarType type, size_t paramIdx);
-    Var* lookupVar(const std::string& name);
-    
-    void declareThingy(const std::string& name, const Thingy& thingy);
-    const Thingy* lookupThingy(const std::string& name);
+    IRBuilder& builder() { return *m_Builder; }
+    IRFunction& fn() { return m_Builder->fn(); }
+    // makes builder the target of all emission until the returned outer builder is restored
+    IRBuilder* switchBuilder(IRBuilder* builder);
+
+    // variables live in virtual registers for their whole scope
+    Value declareVar(NodeIndex decl);
+    const Value& lookupVar(NodeIndex node) const { return m_Vars[m_Annotations.symbolId(node)]; }
+    void assign(const Value& var, const Value& value);
+    void generateBranch(NodeIndex cond, uint32_t falseBlock);
+    bool isCondition(NodeIndex expr) const;
+    // jumps to trueBlock or falseBlock. and / or only evaluate their right side when the left one does not decide
+    void generateCondition(NodeIndex expr, uint32_t trueBlock, uint32_t falseBlock);
+    Value generateLogical(NodeIndex binExpr);
+    void generateReturn(const Value& value, VarType type);
 
     std::string createLabel(const std::string& name = "label");
-    std::string findStringLiteral(const std::string& value);
-    static std::string escapeString(const std::string& input);
-    void generateVariableLoad(const Var* var);
-    void generateVariableStore(const Var* var);
-    
+    uint32_t createBlock(const std::string& name) { return m_Builder->createBlock(createLabel(name)); }
+    uint32_t findStringLiteral(std::string_view value);
+    static std::string unescapeString(std::string_view input);
+    static IRType irType(VarType type);
+
     static void error(const std::string& msg);
 private:
-    const NodeProg m_Prog;
-    std::stringstream m_Output;
-    std::stringstream m_Data;
-    std::unordered_map<std::string, std::string> m_StringLiterals;
-    size_t m_StackSize = 0;
-    std::vector<Scope> m_Scopes;
+    const Ast& m_Ast;
+    const Interner& m_Interner;
+    const Annotations& m_Annotations;
+    IRModule m_Module;
+    IRBuilder* m_Builder = nullptr;
+    std::unordered_map<std::string_view, uint32_t> m_StringLiterals; // source spelling -> m_Module.strings index
+    std::vector<Value> m_Vars; // indexed by SymbolId
+    std::vector<uint32_t> m_ThingyFunctions; // indexed by SymbolId
     size_t m_LabelCount = 0;
-    
-    std::unique_ptr<TypeChecker> m_TypeChecker;
-    std::unique_ptr<OperationGenerator> m_OpGenerator;
-};
\ No newline at end of file
+
+    OperationGenerator m_OpGenerator;
+};
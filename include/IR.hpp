@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// typed three-address code: values live in virtual registers, instructions sit in basic blocks and
+// every block ends in exactly one terminator. temporaries are written once, a variable keeps a single
+// register for its whole scope and may be assigned many times
+using VReg = uint32_t;
+inline constexpr VReg NoVReg = UINT32_MAX;
+
+enum class IRType : uint8_t {
+    Int,
+    Bool,
+    Ptr,
+};
+
+// comparisons are signed, like the setcc codes the language always used
+enum class CmpOp : uint8_t {
+    Eq, Ne, Lt, Le, Gt, Ge,
+};
+
+enum class RuntimeFn : uint8_t {
+    StrCat, // (left ptr, left len, right ptr, right len) -> ptr, len
+    StrMul, // (ptr, len, n) -> ptr, len
+};
+
+enum class IROp : uint8_t {
+    Const,       // dst = imm
+    StrAddr,     // dst = address of string literal imm
+    Copy,        // dst = a
+    Add, Sub, Mul, Div, And, Or, Xor, // dst = a op b, division is unsigned
+    Cmp,         // dst = a cmp b
+    Param,       // dst = argument slot imm
+    Call,        // dst, dst2 = thingy imm (args)
+    CallRuntime, // dst, dst2 = runtime function imm (args)
+    Write,       // write string a, length b to stdout
+    // terminators
+    Exit,        // exit with status a
+    Jmp,         // goto target
+    Br,          // if a != 0 goto target else elseTarget
+    Ret,         // return count values: a, b
+};
+
+struct IRInst {
+    IROp op;
+    CmpOp cmp = CmpOp::Eq;
+    uint8_t count = 0;
+    VReg dst = NoVReg;
+    VReg dst2 = NoVReg; // length of a string result
+    VReg a = NoVReg;
+    VReg b = NoVReg;
+    int64_t imm = 0;
+    uint32_t target = 0;
+    uint32_t elseTarget = 0;
+    uint32_t argBegin = 0; // call arguments, range in IRFunction::args
+    uint32_t argCount = 0;
+};
+
+bool isTerminator(IROp op);
+// a call whose results the ret right after it hands back unchanged
+bool isTailCall(const IRInst& call, const IRInst& ret);
+
+struct IRBlock {
+    std::string name;
+    std::vector<IRInst> insts = {};
+
+    bool terminated() const { return !insts.empty() && isTerminator(insts.back().op); }
+};
+
+struct IRFunction {
+    std::string name; // unique label
+    std::string sourceName = {}; // the thingy's name as written
+    bool isEntry = false;
+    uint32_t paramSlots = 0; // 8 byte argument slots, a string takes two
+    uint8_t returnCount = 0; // registers returned, a string takes two
+    std::vector<IRBlock> blocks = {}; // blocks[0] is the entry
+    std::vector<IRType> types = {}; // indexed by VReg
+    std::vector<VReg> args = {};
+
+    VReg newVReg(const IRType type) {
+        types.push_back(type);
+        return static_cast<VReg>(types.size() - 1);
+    }
+    uint32_t addArgs(const std::vector<VReg>& values);
+
+    // visits the registers an instruction reads
+    template<typename F>
+    void forEachUse(const IRInst& inst, F&& visit) const {
+        if (inst.a != NoVReg) {
+            visit(inst.a);
+        }
+        if (inst.b != NoVReg) {
+            visit(inst.b);
+        }
+        for (uint32_t i = 0; i < inst.argCount; i++) {
+            visit(args[inst.argBegin + i]);
+        }
+    }
+
+    // puts the blocks in the given order and drops the ones left out, branch targets follow along
+    void reorderBlocks(const std::vector<uint32_t>& order);
+};
+
+struct IRModule {
+    std::vector<IRFunction> functions;
+    std::vector<std::string> strings; // literal bytes without the terminating NUL
+    std::unordered_map<std::string, uint32_t> stringIndex;
+
+    // equal literals share one entry
+    uint32_t addString(const std::string& bytes);
+};
+
+// appends instructions to one function of a module. code that follows a terminator lands in a fresh
+// block nothing jumps to, so every block keeps a single terminator at its end
+class IRBuilder {
+public:
+    IRBuilder(IRModule& module, size_t function, std::string entryName);
+
+    IRFunction& fn() { return m_Module.functions[m_Function]; }
+    size_t function() const { return m_Function; }
+
+    uint32_t createBlock(std::string name);
+    void startBlock(uint32_t block); // the current block falls through into it
+    void emit(const IRInst& inst);
+    VReg value(IROp op, IRType type, VReg a = NoVReg, VReg b = NoVReg);
+    VReg constant(int64_t value, IRType type = IRType::Int);
+    void jump(uint32_t block);
+    void branch(VReg cond, uint32_t then, uint32_t otherwise);
+    // lays the blocks out in the order they were started
+    void finish();
+
+private:
+    IRModule& m_Module;
+    size_t m_Function;
+    uint32_t m_Block = 0;
+    std::vector<uint32_t> m_Layout;
+};
+
+std::string printIR(const IRModule& module);
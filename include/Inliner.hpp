@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include "IR.hpp"
+
+// what happened to each thingy's call sites, reported by --stats
+struct InlineStats {
+    struct Thingy {
+        std::string name; // as written in the source, not the label
+        uint32_t cost = 0;
+        bool recursive = false;
+        uint32_t calls = 0; // call sites seen, copies brought in by inlining included
+        uint32_t inlined = 0;
+    };
+    std::vector<Thingy> thingies;
+    uint32_t removed = 0; // thingies no call reaches anymore
+
+    std::string report() const;
+};
+
+// replaces calls to small thingies with a copy of their body, so constant folding and register allocation
+// see through them. parameters become copies of the arguments and every return a copy into the call's
+// results followed by a jump to the code after the call. callees are handled before their callers, a
+// thingy that can reach itself is never inlined, and thingies no call reaches afterwards are dropped
+class Inliner {
+public:
+    Inliner(IRModule& module, InlineStats& stats);
+
+    void run();
+
+private:
+    void findRecursion();
+    // callees before callers, the order inlining has to go in so inlined bodies are already flat
+    std::vector<uint32_t> bottomUpOrder() const;
+    bool inlineCalls(uint32_t caller);
+    void inlineCall(uint32_t caller, uint32_t block, size_t index);
+    void removeUnreachable();
+    static uint32_t cost(const IRFunction& function);
+private:
+    IRModule& m_Module;
+    InlineStats& m_Stats;
+    std::vector<bool> m_Recursive; // indexed like m_Module.functions
+    uint32_t m_InlineCount = 0;
+};
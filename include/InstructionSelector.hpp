@@ -0,0 +1,53 @@
+#pragma once
+
+#include <optional>
+#include "IR.hpp"
+#include "MachineIR.hpp"
+
+// the x86-64 backend: turns IR functions into machine instructions over virtual registers,
+// which the register allocator maps onto physical ones afterwards
+class InstructionSelector {
+public:
+    explicit InstructionSelector(const IRModule& module);
+
+    MModule select();
+
+private:
+    void selectFunction(const IRFunction& function);
+    void selectInst(const IRInst& inst, uint32_t nextBlock);
+    // the jumps for a branch taken when cond holds on the flags set right before
+    void selectBranch(Cond cond, const IRInst& inst, uint32_t nextBlock);
+    void selectBinary(MOp op, const IRInst& inst);
+    // strength reduction for a constant operand, returns false when the generic sequence is needed
+    bool selectMulByConstant(const IRInst& inst);
+    bool selectDivByConstant(const IRInst& inst);
+    void selectCall(const IRInst& inst);
+    // a call whose results are returned right away jumps to the callee, which then returns to our caller
+    bool canTailCall(const IRInst& call, const IRInst& ret) const;
+    void selectTailCall(const IRInst& inst);
+    void selectRuntimeCall(const IRInst& inst);
+
+    // ir registers map one to one onto the first virtual machine registers
+    static MReg reg(const VReg vreg) { return FirstVirtual + vreg; }
+    static Cond condition(CmpOp cmp);
+    static constexpr uint32_t argRegCount = std::size(callArgRegs);
+    // argument slots that do not fit in registers and go on the stack
+    static uint32_t stackSlots(const uint32_t slots) { return slots > argRegCount ? slots - argRegCount : 0; }
+    // where a stack argument slot of the current function sits, right above the return address
+    static Operand stackArg(const uint32_t slot) { return Operand::mem(PhysReg::rbp, 16 + 8 * (slot - argRegCount)); }
+    MFunction& fn() { return m_Module.functions.back(); }
+    uint32_t outLenSlot();
+    const std::optional<int64_t>& constant(const VReg vreg) const { return m_Constants[vreg]; }
+private:
+    const IRModule& m_IR;
+    const IRFunction* m_Current = nullptr;
+    MModule m_Module;
+    std::vector<uint32_t> m_FunctionLabels; // indexed like m_IR.functions
+    std::vector<uint32_t> m_StringLabels; // indexed like m_IR.strings
+    std::vector<uint32_t> m_BlockLabels; // blocks of the current function
+    std::vector<std::optional<int64_t>> m_Constants; // registers of the current function defined once by a constant
+    std::vector<uint32_t> m_UseCount; // indexed by VReg
+    uint32_t m_OutLenSlot = UINT32_MAX;
+    uint32_t m_Strcat;
+    uint32_t m_Strmul;
+};
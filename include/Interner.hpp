@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using NameId = uint32_t;
+
+// maps identifier spellings to small dense ids so later passes compare names as integers
+// the views must point into storage that outlives the interner (the source buffer)
+class Interner {
+public:
+    NameId intern(std::string_view name);
+    std::string_view name(NameId id) const { return m_Names[id]; }
+    size_t size() const { return m_Names.size(); }
+
+private:
+    std::unordered_map<std::string_view, NameId> m_Ids;
+    std::vector<std::string_view> m_Names;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+enum class TokenType;
+
+struct Keyword {
+    std::string_view spelling;
+    TokenType type;
+    std::string_view value = {}; // payload carried by the token (bool literals)
+};
+
+// perfect hash over (length, first char, last char), the multipliers are searched at compile time
+// so every identifier costs exactly one table probe and at most one string compare
+namespace keywords {
+    inline constexpr size_t tableSize = 64;
+
+    struct HashSeed {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    constexpr size_t hash(const std::string_view word, const HashSeed seed) {
+        const auto first = static_cast<unsigned char>(word.front());
+        const auto last = static_cast<unsigned char>(word.back());
+        return (first * seed.first + last * seed.last + word.size()) % tableSize;
+    }
+
+    template<size_t N>
+    constexpr HashSeed findSeed(const std::array<Keyword, N>& list) {
+        for (uint32_t first = 1; first < 256; first++) {
+            for (uint32_t last = 1; last < 256; last++) {
+                std::array<bool, tableSize> used{};
+                bool collision = false;
+                for (const Keyword& keyword : list) {
+                    const size_t slot = hash(keyword.spelling, { first, last });
+                    if (used[slot]) {
+                        collision = true;
+                        break;
+                    }
+                    used[slot] = true;
+                }
+                if (!collision) {
+                    return { first, last };
+                }
+            }
+        }
+        return { 0, 0 };
+    }
+
+    template<size_t N>
+    constexpr std::array<int8_t, tableSize> buildTable(const std::array<Keyword, N>& list, const HashSeed seed) {
+        std::array<int8_t, tableSize> table{};
+        table.fill(-1);
+        for (size_t i = 0; i < N; i++) {
+            table[hash(list[i].spelling, seed)] = static_cast<int8_t>(i);
+        }
+        return table;
+    }
+}
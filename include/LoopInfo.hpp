@@ -0,0 +1,37 @@
+#pragma once
+
+#include "IR.hpp"
+
+// the blocks a block can jump to, none for exit and ret
+std::vector<uint32_t> successors(const IRBlock& block);
+
+struct Loop {
+    uint32_t header;
+    std::vector<bool> blocks; // membership by block index
+    uint32_t size;
+};
+
+// control flow, dominators and natural loops of one function. a snapshot: any pass that adds, removes
+// or reorders blocks builds a new one
+class LoopInfo {
+public:
+    explicit LoopInfo(const IRFunction& function);
+
+    const std::vector<uint32_t>& preds(const uint32_t block) const { return m_Preds[block]; }
+    bool dominates(uint32_t a, uint32_t b) const;
+    // innermost loops come first
+    const std::vector<Loop>& loops() const { return m_Loops; }
+    // the single block outside the loop that jumps to its header, UINT32_MAX when there is none
+    uint32_t preheader(const Loop& loop) const;
+
+private:
+    void buildCfg();
+    void computeDominators();
+    void findLoops();
+private:
+    const IRFunction& m_Function;
+    std::vector<std::vector<uint32_t>> m_Preds;
+    std::vector<uint32_t> m_Idom;
+    std::vector<uint32_t> m_RpoIndex;
+    std::vector<Loop> m_Loops;
+};
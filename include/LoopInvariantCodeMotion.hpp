@@ -0,0 +1,32 @@
+#pragma once
+
+#include "LoopInfo.hpp"
+
+// hoists computations whose operands do not change inside a loop into the loop's preheader, the block
+// control enters the loop from. the loop header runs at least once whenever the preheader does, so anything
+// side effect free moves out of it, a four bound included. elsewhere in the loop only what cannot trap or
+// hang may run ahead of time, which rules out the runtime's string helpers. thingies count as pure when they
+// neither yell nor exit, directly or through a call, and as safe to run ahead of time when they also never
+// divide by a variable, call into the runtime, loop or recurse
+class LoopInvariantCodeMotion {
+public:
+    explicit LoopInvariantCodeMotion(IRModule& module);
+
+    void run();
+
+private:
+    void analyzeThingies();
+    // creates the loop's preheader if it has none. false when the cfg changed
+    bool ensurePreheader(const LoopInfo& info, const Loop& loop);
+    void hoist(uint32_t preheader, const Loop& loop);
+    bool isPure(const IRInst& inst) const;
+    bool isSafe(const IRInst& inst) const;
+    void countDefs();
+private:
+    IRModule& m_Module;
+    IRFunction* m_Function = nullptr;
+    std::vector<bool> m_PureThingies; // indexed like m_Module.functions
+    std::vector<bool> m_SafeThingies;
+    std::vector<uint32_t> m_DefCount; // indexed by VReg
+    std::vector<bool> m_NonZeroConstants; // indexed by VReg
+};
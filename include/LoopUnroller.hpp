@@ -0,0 +1,31 @@
+#pragma once
+
+#include <span>
+#include "LoopInfo.hpp"
+
+// rotates loops so their exit test sits at the bottom: the header's test is copied into every block that
+// jumps back and the original stays in front as a guard, one branch per iteration instead of a test at
+// the top and a jump back to it. a rotated four loop with a straight body and a bound that does not change
+// inside it is then unrolled: copies of the body run factor iterations per test while at least that many
+// remain, and the original loop finishes the rest
+class LoopUnroller {
+public:
+    LoopUnroller(IRModule& module, uint32_t factor);
+
+    void run();
+
+private:
+    bool rotate(const LoopInfo& info, const Loop& loop);
+    bool unroll(const LoopInfo& info, const Loop& loop);
+    // appends a copy of insts, registers written once get fresh ones so the copies stay apart
+    void cloneInto(std::vector<IRInst>& out, std::span<const IRInst> insts);
+    // whether a register written once in the block is read outside of it
+    bool escapes(uint32_t block) const;
+    void countDefs();
+private:
+    IRModule& m_Module;
+    uint32_t m_Factor;
+    IRFunction* m_Function = nullptr;
+    std::vector<uint32_t> m_DefCount; // indexed by VReg
+    std::vector<bool> m_Ones; // indexed by VReg, written once by the constant 1
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// x86-64 general purpose registers in encoding order
+enum class PhysReg : uint8_t {
+    rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15,
+};
+
+// registers below FirstVirtual are physical, the rest are virtual until the register allocator runs
+using MReg = uint32_t;
+inline constexpr MReg FirstVirtual = 16;
+
+constexpr MReg toReg(const PhysReg reg) { return static_cast<MReg>(reg); }
+constexpr bool isVirtual(const MReg reg) { return reg >= FirstVirtual; }
+
+// argument registers shared by calls (System V) and syscalls (the kernel uses r10 instead of rcx)
+inline constexpr PhysReg callArgRegs[] = { PhysReg::rdi, PhysReg::rsi, PhysReg::rdx, PhysReg::rcx, PhysReg::r8, PhysReg::r9 };
+inline constexpr PhysReg syscallArgRegs[] = { PhysReg::rdi, PhysReg::rsi, PhysReg::rdx, PhysReg::r10, PhysReg::r8, PhysReg::r9 };
+inline constexpr PhysReg callerSavedRegs[] = {
+    PhysReg::rax, PhysReg::rcx, PhysReg::rdx, PhysReg::rsi, PhysReg::rdi, PhysReg::r8, PhysReg::r9, PhysReg::r10, PhysReg::r11,
+};
+
+const char* regName(PhysReg reg);
+const char* regName8(PhysReg reg);
+
+struct Operand {
+    enum class Kind : uint8_t {
+        None,
+        Reg,   // reg
+        Imm,   // value
+        Mem,   // qword [reg + value]
+        Slot,  // frame slot number value, turned into memory by the register allocator once the frame is laid out
+        Label, // module label id value
+    };
+
+    Kind kind = Kind::None;
+    MReg reg = 0;
+    int64_t value = 0;
+
+    static Operand r(const MReg reg) { return { Kind::Reg, reg, 0 }; }
+    static Operand r(const PhysReg reg) { return { Kind::Reg, toReg(reg), 0 }; }
+    static Operand imm(const int64_t value) { return { Kind::Imm, 0, value }; }
+    static Operand mem(const PhysReg base, const int64_t disp) { return { Kind::Mem, toReg(base), disp }; }
+    static Operand slot(const uint32_t index) { return { Kind::Slot, 0, index }; }
+    static Operand label(const uint32_t id) { return { Kind::Label, 0, id }; }
+
+    bool isReg() const { return kind == Kind::Reg; }
+    bool isReg(const PhysReg phys) const { return kind == Kind::Reg && reg == toReg(phys); }
+    bool isImm() const { return kind == Kind::Imm; }
+    bool isMemory() const { return kind == Kind::Mem || kind == Kind::Slot; }
+    bool operator==(const Operand& other) const = default;
+};
+
+inline bool fitsImm32(const int64_t value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+enum class Cond : uint8_t {
+    E, NE, L, LE, G, GE, B, BE, A, AE,
+};
+
+const char* condName(Cond cond);
+Cond invertCond(Cond cond);
+
+// two-operand x86 form: dst is written (and read for arithmetic), src is read
+enum class MOp : uint8_t {
+    Label,   // dst: label
+    Mov,
+    Lea,     // src: label or memory
+    LeaScaled, // dst = src + src * count, count is 2, 4 or 8
+    Add, Sub, Imul, And, Or, Xor,
+    Shl, Shr, // src: immediate shift count
+    Cmp,
+    Mul,     // dst: multiplier, rdx:rax = rax * dst unsigned
+    Div,     // dst: divisor, rdx:rax / dst -> rax, remainder rdx
+    Setcc,   // dst: low byte set from cond
+    Movzx8,  // dst = zero extended low byte of src
+    Push,    // dst
+    Pop,     // dst
+    Jmp,     // dst: label
+    Jcc,     // dst: label
+    Call,    // dst: label, count: argument registers read
+    TailCall, // dst: label, count: argument registers read, jumps there after the frame is torn down so the callee returns to our caller
+    Syscall, // count: argument registers read besides rax
+    Ret,     // count: return registers read (rax, rdx)
+};
+
+struct MInst {
+    MOp op;
+    Cond cond = Cond::E;
+    uint8_t count = 0;
+    Operand dst = {};
+    Operand src = {};
+};
+
+bool isTerminator(const MInst& inst); // control never falls through
+
+// visits every register an instruction reads / writes, operands and fixed registers alike.
+// calls write every caller-saved register, that is how clobbers reach the allocator
+template<typename F>
+void forEachUse(const MInst& inst, F&& visit) {
+    switch (inst.op) {
+        case MOp::Mov: case MOp::Lea: case MOp::LeaScaled: case MOp::Setcc: case MOp::Movzx8: case MOp::Pop:
+            if (inst.dst.kind == Operand::Kind::Mem) {
+                visit(inst.dst.reg);
+            }
+            break;
+        default:
+            if (inst.dst.isReg() || inst.dst.kind == Operand::Kind::Mem) {
+                visit(inst.dst.reg);
+            }
+    }
+    if (inst.src.isReg() || inst.src.kind == Operand::Kind::Mem) {
+        visit(inst.src.reg);
+    }
+
+    switch (inst.op) {
+        case MOp::Mul:
+            visit(toReg(PhysReg::rax));
+            break;
+        case MOp::Div:
+            visit(toReg(PhysReg::rax));
+            visit(toReg(PhysReg::rdx));
+            break;
+        case MOp::Call: case MOp::TailCall:
+            for (uint8_t i = 0; i < inst.count; i++) {
+                visit(toReg(callArgRegs[i]));
+            }
+            break;
+        case MOp::Syscall:
+            visit(toReg(PhysReg::rax));
+            for (uint8_t i = 0; i < inst.count; i++) {
+                visit(toReg(syscallArgRegs[i]));
+            }
+            break;
+        case MOp::Ret:
+            if (inst.count > 0) {
+                visit(toReg(PhysReg::rax));
+            }
+            if (inst.count > 1) {
+                visit(toReg(PhysReg::rdx));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+template<typename F>
+void forEachDef(const MInst& inst, F&& visit) {
+    switch (inst.op) {
+        case MOp::Mov: case MOp::Lea: case MOp::LeaScaled: case MOp::Setcc: case MOp::Movzx8: case MOp::Pop:
+        case MOp::Add: case MOp::Sub: case MOp::Imul: case MOp::And: case MOp::Or: case MOp::Xor:
+        case MOp::Shl: case MOp::Shr:
+            if (inst.dst.isReg()) {
+                visit(inst.dst.reg);
+            }
+            break;
+        case MOp::Mul:
+        case MOp::Div:
+            visit(toReg(PhysReg::rax));
+            visit(toReg(PhysReg::rdx));
+            break;
+        case MOp::Call:
+            for (const PhysReg reg : callerSavedRegs) {
+                visit(toReg(reg));
+            }
+            break;
+        case MOp::Syscall:
+            visit(toReg(PhysReg::rax));
+            visit(toReg(PhysReg::rcx));
+            visit(toReg(PhysReg::r11));
+            break;
+        default:
+            break;
+    }
+}
+
+struct MFunction {
+    uint32_t label;
+    bool isEntry = false; // _start: entered without a return address and never returns
+    std::vector<MInst> insts = {};
+    MReg nextVReg = FirstVirtual;
+    uint32_t slotCount = 0; // 8 byte frame slots
+    uint32_t frameSize = 0; // set once the frame is laid out
+
+    MReg newVReg() { return nextVReg++; }
+    uint32_t newSlot() { return slotCount++; }
+    void emit(const MOp op, const Operand dst = {}, const Operand src = {}) { insts.push_back(MInst{ .op = op, .dst = dst, .src = src }); }
+    void emitCond(const MOp op, const Cond cond, const Operand dst) { insts.push_back(MInst{ .op = op, .cond = cond, .dst = dst }); }
+    void emitCounted(const MOp op, const uint8_t count, const Operand dst = {}) { insts.push_back(MInst{ .op = op, .count = count, .dst = dst }); }
+};
+
+// string literals are stored without their terminating NUL, which the printer appends
+struct MData {
+    uint32_t label;
+    std::string bytes;
+};
+
+struct MModule {
+    std::vector<std::string> labels;
+    std::vector<uint32_t> externs;
+    std::vector<MData> data;
+    std::vector<MFunction> functions;
+
+    uint32_t addLabel(std::string name) {
+        labels.push_back(std::move(name));
+        return static_cast<uint32_t>(labels.size() - 1);
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MachineIR.hpp"
+
+// encodes an allocated module as x86-64 machine code and packs it into an ELF64 relocatable object,
+// the same out.o nasm assembles from the printer's output. jumps start out short and are widened
+// until every displacement fits, labels in .data and the runtime are left to the linker
+class ObjectWriter {
+public:
+    explicit ObjectWriter(const MModule& module);
+
+    std::string write();
+
+private:
+    enum class Place : uint8_t {
+        Text,
+        Data,
+        Extern,
+    };
+
+    // a rel8 / rel32 field pointing at a text label, patched once the text is laid out
+    struct Fixup {
+        uint32_t offset; // of the field, the displacement counts from its end
+        uint32_t label;
+        uint32_t branch; // index into m_LongBranch, s_None for a call that is always rel32
+        bool wide;
+    };
+
+    struct Relocation {
+        uint32_t offset;
+        uint32_t label;
+        uint32_t type;
+    };
+
+    static constexpr uint32_t s_None = UINT32_MAX;
+
+    void layoutData();
+    void encodeText();
+    void encodeInst(const MInst& inst);
+    void encodeAlu(uint8_t digit, const MInst& inst);
+    void encodeBranch(uint8_t shortOpcode, std::initializer_list<uint8_t> longOpcode, uint32_t label);
+    void encodeCall(uint32_t label);
+
+    // rex prefix for a register field and a register or memory operand, when one is needed at all.
+    // byteReg forces it so the low byte of rsp, rbp, rsi and rdi can be addressed
+    void rex(bool wide, uint8_t reg, const Operand& rm, bool byteReg = false);
+    void modrm(uint8_t reg, const Operand& rm);
+    void encodeRM(std::initializer_list<uint8_t> opcode, uint8_t reg, const Operand& rm, bool wide = true);
+    void byte(uint8_t value) { m_Text.push_back(static_cast<char>(value)); }
+    void bytes(std::initializer_list<uint8_t> values);
+    void imm32(int64_t value);
+    void imm64(int64_t value);
+
+    std::string buildObject() const;
+    static void error(const std::string& msg);
+private:
+    const MModule& m_Module;
+    std::string m_Text;
+    std::string m_Data;
+    std::vector<Place> m_Places; // indexed by label
+    std::vector<uint32_t> m_Offsets; // into the text or data, indexed by label
+    std::vector<bool> m_LongBranch; // jumps in text order
+    uint32_t m_Branch = 0;
+    std::vector<Fixup> m_Fixups;
+    std::vector<Relocation> m_Relocations;
+};
@@ -1,17 +1,31 @@
 #pragma once
 
+#include "IR.hpp"
 #include "Parser.hpp"
 #include "TypeChecker.hpp"
 
+// a value held in virtual registers, strings take a pointer and a length
+struct Value {
+    VReg reg = NoVReg;
+    VReg len = NoVReg;
+};
+
 class OperationGenerator {
 public:
-    OperationGenerator(std::stringstream& output) : m_Output(output) {}
-    
-    void generateArithmetic(BinOp op, VarType leftType, VarType rightType);
-    void generateComparison(BinOp op, VarType leftType, VarType rightType);
-    void generateLogical(BinOp op, VarType leftType, VarType rightType);
-    void generateBitwise(BinOp op, VarType leftType, VarType rightType);
-    
+    OperationGenerator() = default;
+
+    void setBuilder(IRBuilder& builder);
+
+    Value generateArithmetic(BinOp op, VarType leftType, VarType rightType, Value left, Value right);
+    Value generateComparison(BinOp op, VarType leftType, VarType rightType, Value left, Value right);
+    Value generateBitwise(BinOp op, Value left, Value right); // the type checker rejects strings here
+
+    static CmpOp comparison(BinOp op);
+    // operators other than + and * see a string as its length
+    static VReg scalar(Value value, VarType type);
+
+private:
+    Value callRuntime(RuntimeFn function, const std::vector<VReg>& args);
 private:
-    std::stringstream& m_Output;
+    IRBuilder* m_Builder = nullptr;
 };
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+#include "MachineIR.hpp"
+
+enum class PeepholeRule : uint8_t {
+    PushPop,     // push x; pop y -> mov y, x
+    RedundantMove,
+    ImmediateFold,
+    SetccBranch, // setcc; movzx; cmp 0; jcc -> jcc on the original flags
+    MergeRsp,    // add rsp, n ... sub rsp, m -> add rsp, n - m
+    Count,
+};
+
+// how often each rule fired, summed over every function the optimizer ran on
+struct PeepholeStats {
+    std::array<uint32_t, static_cast<size_t>(PeepholeRule::Count)> fired{};
+
+    std::string report() const;
+};
+
+// rewrites short instruction windows through a table of rules until none of them applies anymore.
+// runs before register allocation, where single-definition virtual registers can be folded away,
+// and again after it on the physical code
+class PeepholeOptimizer {
+public:
+    PeepholeOptimizer(MFunction& function, PeepholeStats& stats);
+
+    void run();
+
+private:
+    // a rule looks at the live instruction i and the ones following it, returns true if it changed something
+    using Rule = bool (PeepholeOptimizer::*)(size_t i);
+    struct RuleEntry {
+        PeepholeRule rule;
+        const char* name;
+        Rule apply;
+    };
+    static const RuleEntry s_Rules[];
+
+    bool pushPop(size_t i);
+    bool redundantMove(size_t i);
+    bool immediateFold(size_t i);
+    bool setccBranch(size_t i);
+    bool mergeRsp(size_t i);
+
+    void countRegisters();
+    size_t next(size_t i) const; // the next live instruction, or insts.size()
+    void remove(size_t i);
+    void use(const Operand& operand, int delta);
+    MInst& inst(const size_t i) { return m_Function.insts[i]; }
+
+    friend struct PeepholeStats;
+private:
+    MFunction& m_Function;
+    PeepholeStats& m_Stats;
+    std::vector<bool> m_Removed;
+    std::vector<uint32_t> m_Uses; // indexed by MReg
+    std::vector<uint32_t> m_Defs;
+    std::vector<std::optional<int64_t>> m_Constants; // virtual registers defined once by mov reg, imm
+};
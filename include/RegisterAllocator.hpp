@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "MachineIR.hpp"
+
+// linear scan over live intervals: every virtual register gets one interval spanning all the positions
+// it is live at, physical registers pinned by instructions (div, calls, syscalls) are fixed ranges that
+// block allocation. intervals that do not fit are spilled to a frame slot for their whole lifetime and
+// reloaded through r10 / r11, which are kept out of allocation for that reason.
+// finishes by laying out the frame and inserting prologue / epilogue, rbp is only set up when rsp moves
+class RegisterAllocator {
+public:
+    explicit RegisterAllocator(MFunction& function);
+
+    void run();
+
+private:
+    static constexpr uint32_t s_None = UINT32_MAX;
+
+    struct Block {
+        uint32_t begin; // instruction range [begin, end)
+        uint32_t end;
+        std::vector<uint32_t> preds;
+    };
+
+    // instruction i reads its operands at position 2i and writes its results at 2i + 1
+    struct Interval {
+        uint32_t start = s_None;
+        uint32_t end = 0;
+        MReg hint = s_None; // register this one is copied from / to
+        uint32_t slot = s_None;
+        int8_t phys = -1;
+    };
+
+    struct Range {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    void buildBlocks();
+    void computeLiveness();
+    void buildFixedRanges();
+    void linearScan();
+    void rewrite();
+    void insertFrame();
+
+    Interval& interval(const MReg reg) { return m_Intervals[reg - FirstVirtual]; }
+    void extend(MReg reg, uint32_t pos);
+    bool isFree(PhysReg reg, const Interval& current, const std::vector<MReg>& active);
+    bool fixedConflict(PhysReg reg, uint32_t start, uint32_t end) const;
+    Operand assigned(const Operand& operand);
+private:
+    MFunction& m_Function;
+    std::vector<Block> m_Blocks;
+    std::vector<Interval> m_Intervals; // indexed by vreg - FirstVirtual
+    std::array<std::vector<Range>, 16> m_Fixed;
+    std::vector<PhysReg> m_SavedRegs;
+};
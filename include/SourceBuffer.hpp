@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// read-only view of the whole input: regular files are memory-mapped,
+// pipes, ttys and stdin ("-") are read into a heap buffer instead
+class SourceBuffer {
+public:
+    SourceBuffer(const std::string& path);
+
+    SourceBuffer(const SourceBuffer& other) = delete;
+    SourceBuffer& operator=(const SourceBuffer& other) = delete;
+
+    ~SourceBuffer();
+
+    std::string_view view() const { return { m_Data, m_Size }; }
+    bool isMapped() const { return m_Mapped; }
+
+private:
+    void readAll(int fd, const std::string& path);
+    static void error(const std::string& path, const std::string& msg);
+private:
+    const char* m_Data = "";
+    size_t m_Size = 0;
+    bool m_Mapped = false;
+    std::string m_Owned;
+};
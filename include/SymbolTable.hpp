@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Interner.hpp"
+
+using SymbolId = uint32_t;
+inline constexpr SymbolId NoSymbol = UINT32_MAX;
+
+// scoped name -> symbol map shared by all scopes: an open-addressing table keyed by interned name
+// points at the innermost binding, each binding links to the one it shadows.
+// the bindings vector doubles as the undo log, leaving a scope pops back to where it started
+class SymbolTable {
+public:
+    // variables and thingies may share a name without clashing
+    enum class Namespace : uint8_t {
+        Var,
+        Thingy,
+    };
+
+    SymbolTable();
+
+    void enterScope();
+    void leaveScope();
+
+    // binds even on failure so later lookups find the newest declaration,
+    // returns false if the name was already bound in the innermost scope
+    bool declare(Namespace ns, NameId name, SymbolId symbol);
+    SymbolId lookup(Namespace ns, NameId name) const;
+
+private:
+    static constexpr uint32_t s_Empty = UINT32_MAX;
+
+    struct Slot {
+        uint32_t key = s_Empty;
+        uint32_t binding = s_Empty; // innermost binding, s_Empty once every scope binding it is gone
+    };
+
+    struct Binding {
+        uint32_t key;
+        SymbolId symbol;
+        uint32_t shadowed; // previous binding of the same key
+        uint32_t depth;
+    };
+
+    static uint32_t makeKey(const Namespace ns, const NameId name) { return name << 1 | static_cast<uint32_t>(ns); }
+    size_t findSlot(uint32_t key) const;
+    void grow();
+private:
+    std::vector<Slot> m_Slots; // power of two, keys are never removed so no tombstones are needed
+    uint32_t m_Shift = 26; // 32 - log2(slot count)
+    size_t m_Used = 0;
+    std::vector<Binding> m_Bindings;
+    std::vector<uint32_t> m_ScopeMarks;
+};
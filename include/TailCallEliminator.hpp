@@ -0,0 +1,19 @@
+#pragma once
+
+#include "IR.hpp"
+
+// turns a thingy's calls to itself whose result it returns right away into a jump back to its start:
+// the arguments are copied into the parameters and the body runs again in the same frame, so recursion
+// like gcd or an accumulator runs in constant stack. tail calls to other thingies are left to the
+// instruction selector, which jumps to the callee instead of calling it
+class TailCallEliminator {
+public:
+    explicit TailCallEliminator(IRModule& module);
+
+    void run();
+
+private:
+    void eliminate(IRFunction& function, const std::vector<uint32_t>& sites);
+private:
+    IRModule& m_Module;
+};
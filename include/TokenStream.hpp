@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include "Tokenizer.hpp"
+
+// pulls tokens from the tokenizer on demand and keeps only the window the parser can look at:
+// the previous token (for end of file errors), the current one and one token of lookahead
+class TokenStream {
+public:
+    TokenStream(Tokenizer& tokenizer);
+
+    const Token* peek(int offset = 0) const;
+    Token consume();
+
+private:
+    void fill();
+private:
+    static constexpr int s_Behind = 1;
+    static constexpr int s_Ahead = 1;
+    static constexpr size_t s_Capacity = 4; // power of two >= s_Behind + 1 + s_Ahead
+
+    Tokenizer& m_Tokenizer;
+    std::array<Token, s_Capacity> m_Ring{};
+    size_t m_Index = 0; // absolute position of the current token
+    size_t m_Pulled = 0; // absolute count of tokens read from the tokenizer
+    bool m_Exhausted = false;
+};
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <array>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "Interner.hpp"
+#include "Keywords.hpp"
 
 enum class TokenType {
     gimme, // let
@@ -57,20 +61,47 @@ enum class TokenType {
     yell, // print
 };
 
+inline constexpr auto keywordList = std::to_array<Keyword>({
+    { "bye", TokenType::bye },
+    { "yell", TokenType::yell },
+    { "gimme", TokenType::gimme },
+    { "yep", TokenType::_bool, "1" },
+    { "nope", TokenType::_bool, "0" },
+    { "thingy", TokenType::thingy },
+    { "gimmeback", TokenType::gimmeback },
+    { "four", TokenType::four },
+    { "in", TokenType::in },
+    { "why", TokenType::why },
+    { "maybe", TokenType::maybe },
+    { "but", TokenType::but },
+    { "nah", TokenType::nah },
+    { "and", TokenType::_and },
+    { "or", TokenType::_or },
+    { "band", TokenType::band },
+    { "bor", TokenType::bor },
+    { "xor", TokenType::_xor },
+    { "number", TokenType::type_number },
+    { "str", TokenType::type_string },
+    { "bool", TokenType::type_bool },
+});
+
+inline constexpr keywords::HashSeed keywordSeed = keywords::findSeed(keywordList);
+static_assert(keywordSeed.first != 0, "no collision-free seed for the keyword list, grow keywords::tableSize");
+inline constexpr auto keywordTable = keywords::buildTable(keywordList, keywordSeed);
+
+inline const Keyword* findKeyword(const std::string_view word) {
+    const int8_t index = keywordTable[keywords::hash(word, keywordSeed)];
+    if (index < 0 || keywordList[index].spelling != word) {
+        return nullptr;
+    }
+    return &keywordList[index];
+}
+
 inline std::string toString(const TokenType& type) {
     switch(type) {
-        case TokenType::gimme: return "'gimme'";
         case TokenType::ident: return "identifier";
         case TokenType::eq: return "'='";
         case TokenType::colon: return "':'";
-        case TokenType::type_number: return "'number'";
-        case TokenType::type_string: return "'str'";
-        case TokenType::type_bool: return "'bool'";
-        case TokenType::_or: return "'or'";
-        case TokenType::_and: return "'and'";
-        case TokenType::bor: return "'lor'";
-        case TokenType::band: return "'land'";
-        case TokenType::_xor: return "'xor'";
         case TokenType::neq: return "'!='";
         case TokenType::eqeq: return "'=='";
         case TokenType::ge: return "'>='";
@@ -85,23 +116,19 @@ inline std::string toString(const TokenType& type) {
         case TokenType::close_paren: return "')'";
         case TokenType::open_curly: return "'{'";
         case TokenType::close_curly: return "'}'";
-        case TokenType::bye: return "'bye'";
         case TokenType::semi: return "';'";
         case TokenType::int_lit: return "int literal";
         case TokenType::string: return "'string'";
-        case TokenType::_bool: return "'bool'";
-        case TokenType::thingy: return "'thingy'";
-        case TokenType::gimmeback: return "'gimmeback'";
-        case TokenType::maybe: return "'maybe'";
-        case TokenType::but: return "'but'";
-        case TokenType::nah: return "'nah'";
-        case TokenType::why: return "'why'";
-        case TokenType::four: return "'loop'";
-        case TokenType::in: return "'in'";
+        case TokenType::_bool: return "bool literal";
         case TokenType::dot: return "'.'";
         case TokenType::comma: return "','";
-        case TokenType::yell: return "'yell'";
-        default: return "unknown";
+        default:
+            for (const Keyword& keyword : keywordList) {
+                if (keyword.type == type) {
+                    return "'" + std::string(keyword.spelling) + "'";
+                }
+            }
+            return "unknown";
     }
 }
 
@@ -136,21 +163,29 @@ struct Token {
     TokenType type;
     size_t line;
     size_t col;
-    std::optional<std::string> value;
+    std::string_view value = {}; // view into the source buffer (or a static literal for bools)
+    NameId id = 0; // interned name, only meaningful for TokenType::ident
 };
 
 class Tokenizer {
 public:
-    Tokenizer(std::string src);
-    std::vector<Token> tokenize();
+    Tokenizer(std::string_view src, Interner& interner);
+    std::optional<Token> next(); // empty once the source is exhausted
 
 private:
-    std::optional<char> peek(size_t offset = 0) const;
+    char peek(size_t offset = 0) const; // '\0' past the end
     char consume();
+    void advanceTo(const char* pos); // bulk move, counts the newlines skipped over
+    std::string_view view(size_t start) const;
+
+    const char* cursor() const { return m_Src.data() + m_Index; }
+    const char* end() const { return m_Src.data() + m_Src.size(); }
+    size_t col() const { return m_Index - m_LineStart + 1; }
 private:
     size_t m_Index = 0;
     size_t m_Line = 1;
-    size_t m_Col = 1;
-    const std::string m_Src;
+    size_t m_LineStart = 0;
+    const std::string_view m_Src; // owned by the SourceBuffer, tokens point into it
+    Interner& m_Interner;
 };
 
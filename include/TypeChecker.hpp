@@ -1,9 +1,10 @@
 #pragma once
 
-#include <sstream>
-#include <unordered_map>
-#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include "Parser.hpp"
+#include "SymbolTable.hpp"
 
 
 enum class VarType {
@@ -30,49 +31,59 @@ inline VarType tokenTypeToVarType(TokenType type) {
     }
 }
 
-struct Var {
-    size_t size = 8;
-    VarType type;
-    size_t stackLoc;
-    bool isParam;
+enum class SymbolKind : uint8_t {
+    Var,
+    Param,
+    Thingy,
 };
 
-struct Thingy {
-    std::vector<VarType> paramTypes;
-    VarType returnType;
-    std::string label;
+struct Symbol {
+    NameId name;
+    SymbolKind kind;
+    VarType type; // return type for thingies
+    NodeIndex decl; // Gimme, Four, Param or Thingy node
+    NodeIndex owner; // Thingy node whose frame holds it, the root for the main body
 };
 
-struct Scope {
-    std::unordered_map<std::string, Var> vars;
-    std::unordered_map<std::string, Thingy> functions;
-    size_t stackStart;
-};
+// results of the semantic pass, indexed by NodeIndex:
+// the type of every expression and the symbol every name refers to or declares
+struct Annotations {
+    std::vector<VarType> types;
+    std::vector<SymbolId> symbols;
+    std::vector<Symbol> symbolTable;
 
-struct TypeInfo {
-    VarType type;
-    bool isValid = true;
-    std::string errorMsg;
-    
-    static TypeInfo error(const std::string& msg) {
-        return TypeInfo{VarType::Number, false, msg};
-    }
-    
-    static TypeInfo valid(VarType t) {
-        return TypeInfo{t, true, ""};
-    }
+    VarType type(const NodeIndex node) const { return types[node]; }
+    SymbolId symbolId(const NodeIndex node) const { return symbols[node]; }
+    const Symbol& symbol(const NodeIndex node) const { return symbolTable[symbols[node]]; }
 };
 
+// resolves names and types in one walk over the tree, in the same order the generator emits code.
+// every error is collected and reported together, a failed expression does not report again further up
 class TypeChecker {
 public:
-    TypeChecker(const std::vector<Scope>& scopes);
-    
-    TypeInfo checkExpr(const NodeExpr* expr);
-    TypeInfo checkTerm(const NodeTerm* term);
-    TypeInfo checkBinExpr(const NodeBinExpr* binExpr);
-    
+    TypeChecker(const Ast& ast, const Interner& interner);
+
+    Annotations check();
+
 private:
-    const Var* lookupVar(const std::string& name);
-    const Thingy* lookupThingy(const std::string& name);
-    const std::vector<Scope>& m_Scopes;
-};
\ No newline at end of file
+    std::optional<VarType> checkExpr(NodeIndex expr);
+    std::optional<VarType> checkTerm(NodeIndex term);
+    std::optional<VarType> checkBinExpr(NodeIndex binExpr);
+    void checkScope(NodeIndex scope);
+    void checkMaybePred(NodeIndex pred);
+    void checkThingy(NodeIndex stmtThingy);
+    void checkStmt(NodeIndex stmt);
+
+    SymbolId declare(NodeIndex decl, SymbolKind kind, VarType type);
+    SymbolId resolveVar(NameId name);
+    std::optional<VarType> annotate(NodeIndex node, std::optional<VarType> type);
+
+    void error(std::string msg);
+private:
+    const Ast& m_Ast;
+    const Interner& m_Interner;
+    Annotations m_Result;
+    SymbolTable m_Symbols;
+    NodeIndex m_Owner = NoNode; // thingy being checked
+    std::vector<std::string> m_Errors;
+};
@@ -0,0 +1,176 @@
+#include "AsmPrinter.hpp"
+
+#include <format>
+
+AsmPrinter::AsmPrinter(const MModule& module) : m_Module(module) {
+
+}
+
+std::string AsmPrinter::print() {
+    m_Output << "section .data\n";
+    for (const MData& data : m_Module.data) {
+        printData(data);
+    }
+
+    m_Output << "section .text\n";
+    m_Output << "\tglobal _start\n";
+    for (const uint32_t label : m_Module.externs) {
+        m_Output << "\textern " << m_Module.labels[label] << "\n";
+    }
+
+    for (const MFunction& function : m_Module.functions) {
+        m_Output << "\n";
+        printFunction(function);
+    }
+
+    return m_Output.str();
+}
+
+void AsmPrinter::printData(const MData& data) {
+    // printable runs go in quotes, every other byte as a number
+    m_Output << "\t" << m_Module.labels[data.label] << " db ";
+    bool quoted = false;
+    for (const char c : data.bytes) {
+        const bool printable = c >= ' ' && c <= '~' && c != '"';
+        if (printable && !quoted) {
+            m_Output << "\"";
+            quoted = true;
+        } else if (!printable) {
+            m_Output << (quoted ? "\", " : "") << static_cast<int>(static_cast<unsigned char>(c)) << ", ";
+            quoted = false;
+        }
+        if (printable) {
+            m_Output << c;
+        }
+    }
+    m_Output << (quoted ? "\", " : "") << "0\n";
+}
+
+void AsmPrinter::printFunction(const MFunction& function) {
+    m_Output << m_Module.labels[function.label] << ":\n";
+    for (const MInst& inst : function.insts) {
+        printInst(inst);
+    }
+}
+
+void AsmPrinter::printInst(const MInst& inst) {
+    switch (inst.op) {
+        case MOp::Label:
+            m_Output << m_Module.labels[inst.dst.value] << ":\n";
+            return;
+        case MOp::Mov:
+            m_Output << "\tmov " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Lea:
+            m_Output << "\tlea " << operand(inst.dst) << ", " << address(inst.src) << "\n";
+            return;
+        case MOp::LeaScaled:
+            m_Output << "\tlea " << operand(inst.dst) << ", [" << operand(inst.src) << " + " << operand(inst.src)
+                << " * " << static_cast<int>(inst.count) << "]\n";
+            return;
+        case MOp::Add:
+            m_Output << "\tadd " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Sub:
+            m_Output << "\tsub " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Imul:
+            m_Output << "\timul " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::And:
+            m_Output << "\tand " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Or:
+            m_Output << "\tor " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Xor:
+            m_Output << "\txor " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Cmp:
+            m_Output << "\tcmp " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Shl:
+            m_Output << "\tshl " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Shr:
+            m_Output << "\tshr " << operand(inst.dst) << ", " << operand(inst.src) << "\n";
+            return;
+        case MOp::Mul:
+            m_Output << "\tmul " << operand(inst.dst) << "\n";
+            return;
+        case MOp::Div:
+            m_Output << "\tdiv " << operand(inst.dst) << "\n";
+            return;
+        case MOp::Setcc:
+            m_Output << "\tset" << condName(inst.cond) << " " << reg8(inst.dst) << "\n";
+            return;
+        case MOp::Movzx8:
+            m_Output << "\tmovzx " << operand(inst.dst) << ", " << reg8(inst.src) << "\n";
+            return;
+        case MOp::Push:
+            m_Output << "\tpush " << operand(inst.dst) << "\n";
+            return;
+        case MOp::Pop:
+            m_Output << "\tpop " << operand(inst.dst) << "\n";
+            return;
+        case MOp::Jmp:
+            m_Output << "\tjmp " << m_Module.labels[inst.dst.value] << "\n";
+            return;
+        case MOp::Jcc:
+            m_Output << "\tj" << condName(inst.cond) << " " << m_Module.labels[inst.dst.value] << "\n";
+            return;
+        case MOp::Call:
+            m_Output << "\tcall " << m_Module.labels[inst.dst.value] << "\n";
+            return;
+        case MOp::TailCall:
+            m_Output << "\tjmp " << m_Module.labels[inst.dst.value] << "\n";
+            return;
+        case MOp::Syscall:
+            m_Output << "\tsyscall\n";
+            return;
+        case MOp::Ret:
+            m_Output << "\tret\n";
+            return;
+    }
+}
+
+std::string AsmPrinter::operand(const Operand& operand) const {
+    switch (operand.kind) {
+        case Operand::Kind::Reg:
+            return regName(static_cast<PhysReg>(operand.reg));
+        case Operand::Kind::Imm:
+            return std::to_string(operand.value);
+        case Operand::Kind::Mem:
+            return "qword " + address(operand);
+        case Operand::Kind::Label:
+            return m_Module.labels[operand.value];
+        case Operand::Kind::Slot:
+        case Operand::Kind::None:
+            break;
+    }
+    return "";
+}
+
+std::string AsmPrinter::address(const Operand& operand) const {
+    switch (operand.kind) {
+        case Operand::Kind::Mem:
+            if (operand.value < 0) {
+                return std::format("[{} - {}]", regName(static_cast<PhysReg>(operand.reg)), -operand.value);
+            }
+            if (operand.value == 0) {
+                return std::format("[{}]", regName(static_cast<PhysReg>(operand.reg)));
+            }
+            return std::format("[{} + {}]", regName(static_cast<PhysReg>(operand.reg)), operand.value);
+        case Operand::Kind::Label:
+            return std::format("[rel {}]", m_Module.labels[operand.value]);
+        default:
+            return operand.kind == Operand::Kind::Reg ? std::format("[{}]", regName(static_cast<PhysReg>(operand.reg))) : "";
+    }
+}
+
+std::string AsmPrinter::reg8(const Operand& operand) const {
+    if (operand.isReg()) {
+        return regName8(static_cast<PhysReg>(operand.reg));
+    }
+    return "byte " + address(operand);
+}
@@ -0,0 +1,37 @@
+#include "Ast.hpp"
+
+Ast::Branch Ast::branch(const NodeIndex node) const {
+    const NodeData d = m_Data[node];
+    return { d.lhs, m_Extra[d.rhs], m_Extra[d.rhs + 1] };
+}
+
+Ast::Loop Ast::loop(const NodeIndex node) const {
+    const NodeData d = m_Data[node];
+    return { m_Extra[d.lhs], m_Extra[d.lhs + 1], d.rhs };
+}
+
+Ast::Proto Ast::proto(const NodeIndex node) const {
+    const NodeData d = m_Data[node];
+    const uint32_t begin = m_Extra[d.lhs];
+    const uint32_t end = m_Extra[d.lhs + 1];
+    return { std::span(m_Extra).subspan(begin, end - begin), static_cast<TokenType>(m_Extra[d.lhs + 2]), d.rhs };
+}
+
+NodeIndex Ast::addNode(const NodeKind kind, const uint32_t main /*=0*/, const NodeData data /*={}*/) {
+    const auto node = static_cast<NodeIndex>(m_Kinds.size());
+    m_Kinds.push_back(kind);
+    m_Main.push_back(main);
+    m_Data.push_back(data);
+    return node;
+}
+
+uint32_t Ast::addString(const std::string_view value) {
+    m_Strings.push_back(value);
+    return static_cast<uint32_t>(m_Strings.size() - 1);
+}
+
+uint32_t Ast::addExtra(const std::span<const uint32_t> values) {
+    const auto start = static_cast<uint32_t>(m_Extra.size());
+    m_Extra.insert(m_Extra.end(), values.begin(), values.end());
+    return start;
+}
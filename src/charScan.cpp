@@ -0,0 +1,272 @@
+#include "CharScan.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define WHACKY_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define WHACKY_SCAN_X86 0
+#endif
+
+namespace scan {
+namespace {
+    struct Impl {
+        Level level;
+        const char* (*skipWhitespace)(const char*, const char*);
+        const char* (*skipAlnum)(const char*, const char*);
+        const char* (*skipDigits)(const char*, const char*);
+        const char* (*findChar)(const char*, const char*, char);
+        const char* (*findCommentEnd)(const char*, const char*);
+        NewlineCount (*countNewlines)(const char*, const char*);
+    };
+
+    struct Space {
+        static bool scalar(const char c) { return isSpace(c); }
+    };
+
+    struct Alnum {
+        static bool scalar(const char c) { return isAlnum(c); }
+    };
+
+    struct Digit {
+        static bool scalar(const char c) { return isDigit(c); }
+    };
+
+    template<typename Class>
+    const char* skipScalar(const char* p, const char* end) {
+        while (p < end && Class::scalar(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    const char* findCharScalar(const char* p, const char* end, const char c) {
+        while (p < end && *p != c) {
+            p++;
+        }
+        return p;
+    }
+
+    const char* findCommentEndScalar(const char* p, const char* end) {
+        while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) {
+            p++;
+        }
+        return p + 1 < end ? p : end;
+    }
+
+    NewlineCount countNewlinesScalar(const char* p, const char* end) {
+        NewlineCount result;
+        for (; p < end; p++) {
+            if (*p == '\n') {
+                result.count++;
+                result.last = p;
+            }
+        }
+        return result;
+    }
+
+#if WHACKY_SCAN_X86
+    // lanes where lo <= v <= hi, as unsigned bytes
+    inline __m128i inRange(const __m128i v, const char lo, const char hi) {
+        const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), shifted);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i inRange(const __m256i v, const char lo, const char hi) {
+        const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), shifted);
+    }
+
+    struct SpaceVec : Space {
+        static __m128i sse2(const __m128i v) {
+            return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', '\r'));
+        }
+        __attribute__((target("avx2")))
+        static __m256i avx2(const __m256i v) {
+            return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange(v, '\t', '\r'));
+        }
+    };
+
+    struct AlnumVec : Alnum {
+        static __m128i sse2(const __m128i v) {
+            return _mm_or_si128(inRange(v, '0', '9'), inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'));
+        }
+        __attribute__((target("avx2")))
+        static __m256i avx2(const __m256i v) {
+            return _mm256_or_si256(inRange(v, '0', '9'), inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'));
+        }
+    };
+
+    struct DigitVec : Digit {
+        static __m128i sse2(const __m128i v) { return inRange(v, '0', '9'); }
+        __attribute__((target("avx2")))
+        static __m256i avx2(const __m256i v) { return inRange(v, '0', '9'); }
+    };
+
+    inline __m128i load16(const char* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i load32(const char* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    template<typename Class>
+    const char* skipSse2(const char* p, const char* end) {
+        while (end - p >= 16) {
+            const unsigned miss = ~_mm_movemask_epi8(Class::sse2(load16(p))) & 0xFFFFu;
+            if (miss) {
+                return p + __builtin_ctz(miss);
+            }
+            p += 16;
+        }
+        return skipScalar<Class>(p, end);
+    }
+
+    template<typename Class>
+    __attribute__((target("avx2")))
+    const char* skipAvx2(const char* p, const char* end) {
+        while (end - p >= 32) {
+            const unsigned miss = ~static_cast<unsigned>(_mm256_movemask_epi8(Class::avx2(load32(p))));
+            if (miss) {
+                return p + __builtin_ctz(miss);
+            }
+            p += 32;
+        }
+        return skipSse2<Class>(p, end);
+    }
+
+    const char* findCharSse2(const char* p, const char* end, const char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        while (end - p >= 16) {
+            const unsigned hit = _mm_movemask_epi8(_mm_cmpeq_epi8(load16(p), needle));
+            if (hit) {
+                return p + __builtin_ctz(hit);
+            }
+            p += 16;
+        }
+        return findCharScalar(p, end, c);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCharAvx2(const char* p, const char* end, const char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        while (end - p >= 32) {
+            const unsigned hit = _mm256_movemask_epi8(_mm256_cmpeq_epi8(load32(p), needle));
+            if (hit) {
+                return p + __builtin_ctz(hit);
+            }
+            p += 32;
+        }
+        return findCharSse2(p, end, c);
+    }
+
+    // compares the block with itself shifted by one byte, so a "*/" straddling two blocks is still seen
+    const char* findCommentEndSse2(const char* p, const char* end) {
+        const __m128i star = _mm_set1_epi8('*');
+        const __m128i slash = _mm_set1_epi8('/');
+        while (end - p >= 17) {
+            const __m128i both = _mm_and_si128(_mm_cmpeq_epi8(load16(p), star), _mm_cmpeq_epi8(load16(p + 1), slash));
+            const unsigned hit = _mm_movemask_epi8(both);
+            if (hit) {
+                return p + __builtin_ctz(hit);
+            }
+            p += 16;
+        }
+        return findCommentEndScalar(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCommentEndAvx2(const char* p, const char* end) {
+        const __m256i star = _mm256_set1_epi8('*');
+        const __m256i slash = _mm256_set1_epi8('/');
+        while (end - p >= 33) {
+            const __m256i both = _mm256_and_si256(_mm256_cmpeq_epi8(load32(p), star), _mm256_cmpeq_epi8(load32(p + 1), slash));
+            const unsigned hit = _mm256_movemask_epi8(both);
+            if (hit) {
+                return p + __builtin_ctz(hit);
+            }
+            p += 32;
+        }
+        return findCommentEndSse2(p, end);
+    }
+
+    NewlineCount countNewlinesSse2(const char* p, const char* end) {
+        NewlineCount result;
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (end - p >= 16) {
+            const unsigned hit = _mm_movemask_epi8(_mm_cmpeq_epi8(load16(p), newline));
+            if (hit) {
+                result.count += __builtin_popcount(hit);
+                result.last = p + 31 - __builtin_clz(hit);
+            }
+            p += 16;
+        }
+        const NewlineCount tail = countNewlinesScalar(p, end);
+        result.count += tail.count;
+        if (tail.last) {
+            result.last = tail.last;
+        }
+        return result;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    NewlineCount countNewlinesAvx2(const char* p, const char* end) {
+        NewlineCount result;
+        const __m256i newline = _mm256_set1_epi8('\n');
+        while (end - p >= 32) {
+            const unsigned hit = _mm256_movemask_epi8(_mm256_cmpeq_epi8(load32(p), newline));
+            if (hit) {
+                result.count += __builtin_popcount(hit);
+                result.last = p + 31 - __builtin_clz(hit);
+            }
+            p += 32;
+        }
+        const NewlineCount tail = countNewlinesSse2(p, end);
+        result.count += tail.count;
+        if (tail.last) {
+            result.last = tail.last;
+        }
+        return result;
+    }
+#endif
+
+    Impl selectImpl() {
+#if WHACKY_SCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return { Level::AVX2, skipAvx2<SpaceVec>, skipAvx2<AlnumVec>, skipAvx2<DigitVec>, findCharAvx2, findCommentEndAvx2, countNewlinesAvx2 };
+        }
+        return { Level::SSE2, skipSse2<SpaceVec>, skipSse2<AlnumVec>, skipSse2<DigitVec>, findCharSse2, findCommentEndSse2, countNewlinesSse2 };
+#else
+        return { Level::Scalar, skipScalar<Space>, skipScalar<Alnum>, skipScalar<Digit>, findCharScalar, findCommentEndScalar, countNewlinesScalar };
+#endif
+    }
+
+    const Impl& impl() {
+        static const Impl selected = selectImpl();
+        return selected;
+    }
+}
+
+const char* skipWhitespace(const char* p, const char* end) { return impl().skipWhitespace(p, end); }
+const char* skipAlnum(const char* p, const char* end) { return impl().skipAlnum(p, end); }
+const char* skipDigits(const char* p, const char* end) { return impl().skipDigits(p, end); }
+const char* findChar(const char* p, const char* end, const char c) { return impl().findChar(p, end, c); }
+const char* findCommentEnd(const char* p, const char* end) { return impl().findCommentEnd(p, end); }
+NewlineCount countNewlines(const char* p, const char* end) { return impl().countNewlines(p, end); }
+
+Level level() {
+    return impl().level;
+}
+
+const char* levelName(const Level level) {
+    switch (level) {
+        case Level::Scalar: return "scalar";
+        case Level::SSE2: return "sse2";
+        case Level::AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+}
@@ -0,0 +1,228 @@
+#include "ConstantFolder.hpp"
+
+#include <algorithm>
+
+namespace {
+    // repeated strings are folded up to this many bytes, bigger ones are left to the runtime
+    constexpr size_t maxFoldedString = 4096;
+}
+
+ConstantFolder::ConstantFolder(IRModule& module) : m_Module(module) {
+
+}
+
+void ConstantFolder::run() {
+    for (IRFunction& function : m_Module.functions) {
+        foldFunction(function);
+        removeUnusedConstants(function);
+    }
+}
+
+void ConstantFolder::foldFunction(IRFunction& function) {
+    m_Function = &function;
+    m_Known.assign(function.types.size(), {});
+    m_DefCount.assign(function.types.size(), 0);
+    for (const IRBlock& block : function.blocks) {
+        for (const IRInst& inst : block.insts) {
+            if (inst.dst != NoVReg) {
+                m_DefCount[inst.dst]++;
+            }
+            if (inst.dst2 != NoVReg) {
+                m_DefCount[inst.dst2]++;
+            }
+        }
+    }
+
+    // blocks are laid out in source order, so a definition is seen before the uses it dominates
+    std::vector<IRInst> folded;
+    for (IRBlock& block : function.blocks) {
+        folded.clear();
+        for (const IRInst& inst : block.insts) {
+            const size_t first = folded.size();
+            if (!fold(inst, folded)) {
+                folded.push_back(inst);
+            }
+            for (size_t i = first; i < folded.size(); i++) {
+                const IRInst& result = folded[i];
+                if (result.dst == NoVReg || m_DefCount[result.dst] != 1) {
+                    continue;
+                }
+                if (result.op == IROp::Const) {
+                    m_Known[result.dst] = { Known::Kind::Int, result.imm };
+                } else if (result.op == IROp::StrAddr) {
+                    m_Known[result.dst] = { Known::Kind::Str, result.imm };
+                }
+            }
+        }
+        block.insts.swap(folded);
+    }
+}
+
+bool ConstantFolder::fold(const IRInst& inst, std::vector<IRInst>& out) {
+    if (inst.dst == NoVReg || m_DefCount[inst.dst] != 1) {
+        return false;
+    }
+
+    switch (inst.op) {
+        case IROp::Copy: {
+            const Known& source = known(inst.a);
+            if (source.kind == Known::Kind::None) {
+                return false;
+            }
+            out.push_back(IRInst{ .op = source.kind == Known::Kind::Str ? IROp::StrAddr : IROp::Const, .dst = inst.dst, .imm = source.value });
+            return true;
+        }
+
+        case IROp::Add: case IROp::Sub: case IROp::Mul: case IROp::Div:
+        case IROp::And: case IROp::Or: case IROp::Xor: {
+            const std::optional<int64_t> a = knownInt(inst.a);
+            const std::optional<int64_t> b = knownInt(inst.b);
+            if (!a.has_value() || !b.has_value()) {
+                return false;
+            }
+            const std::optional<int64_t> result = foldBinary(inst.op, a.value(), b.value());
+            if (!result.has_value()) {
+                return false;
+            }
+            out.push_back(IRInst{ .op = IROp::Const, .dst = inst.dst, .imm = result.value() });
+            return true;
+        }
+
+        case IROp::Cmp: {
+            const std::optional<int64_t> a = knownInt(inst.a);
+            const std::optional<int64_t> b = knownInt(inst.b);
+            if (!a.has_value() || !b.has_value()) {
+                return false;
+            }
+            out.push_back(IRInst{ .op = IROp::Const, .dst = inst.dst, .imm = compare(inst.cmp, a.value(), b.value()) });
+            return true;
+        }
+
+        case IROp::CallRuntime:
+            return foldRuntimeCall(inst, out);
+
+        default:
+            return false;
+    }
+}
+
+bool ConstantFolder::foldRuntimeCall(const IRInst& inst, std::vector<IRInst>& out) {
+    if (m_DefCount[inst.dst2] != 1) {
+        return false;
+    }
+
+    const VReg* args = m_Function->args.data() + inst.argBegin;
+    std::string bytes;
+    if (static_cast<RuntimeFn>(inst.imm) == RuntimeFn::StrCat) {
+        const std::optional<std::string> left = stringBytes(args[0], args[1]);
+        const std::optional<std::string> right = stringBytes(args[2], args[3]);
+        if (!left.has_value() || !right.has_value()) {
+            return false;
+        }
+        bytes = left.value() + right.value();
+    } else {
+        // repeating zero times leaves the runtime without a result to copy
+        const std::optional<std::string> str = stringBytes(args[0], args[1]);
+        const std::optional<int64_t> n = knownInt(args[2]);
+        if (!str.has_value() || !n.has_value() || n.value() < 1
+            || static_cast<uint64_t>(n.value()) > maxFoldedString / std::max<size_t>(str->size(), 1)) {
+            return false;
+        }
+        for (int64_t i = 0; i < n.value(); i++) {
+            bytes += str.value();
+        }
+    }
+
+    // the data section terminates every literal, so a trailing NUL need not be stored
+    const auto length = static_cast<int64_t>(bytes.size());
+    if (!bytes.empty() && bytes.back() == '\0') {
+        bytes.pop_back();
+    }
+    out.push_back(IRInst{ .op = IROp::StrAddr, .dst = inst.dst, .imm = m_Module.addString(bytes) });
+    out.push_back(IRInst{ .op = IROp::Const, .dst = inst.dst2, .imm = length });
+    return true;
+}
+
+std::optional<int64_t> ConstantFolder::foldBinary(const IROp op, const int64_t a, const int64_t b) {
+    // wrap around like the machine does
+    const auto ua = static_cast<uint64_t>(a);
+    const auto ub = static_cast<uint64_t>(b);
+    switch (op) {
+        case IROp::Add:
+            return static_cast<int64_t>(ua + ub);
+        case IROp::Sub:
+            return static_cast<int64_t>(ua - ub);
+        case IROp::Mul:
+            return static_cast<int64_t>(ua * ub);
+        case IROp::Div:
+            // a division by zero has to trap at runtime
+            if (ub == 0) {
+                return {};
+            }
+            return static_cast<int64_t>(ua / ub);
+        case IROp::And:
+            return a & b;
+        case IROp::Or:
+            return a | b;
+        case IROp::Xor:
+            return a ^ b;
+        default:
+            return {};
+    }
+}
+
+bool ConstantFolder::compare(const CmpOp cmp, const int64_t a, const int64_t b) {
+    switch (cmp) {
+        case CmpOp::Eq: return a == b;
+        case CmpOp::Ne: return a != b;
+        case CmpOp::Lt: return a < b;
+        case CmpOp::Le: return a <= b;
+        case CmpOp::Gt: return a > b;
+        case CmpOp::Ge: return a >= b;
+    }
+    return false;
+}
+
+std::optional<std::string> ConstantFolder::stringBytes(const VReg ptr, const VReg len) const {
+    const std::optional<int64_t> length = knownInt(len);
+    if (known(ptr).kind != Known::Kind::Str || !length.has_value()) {
+        return {};
+    }
+
+    // a literal is followed by its NUL, a length moved past that would read unknown memory
+    const std::string& literal = m_Module.strings[known(ptr).value];
+    if (length.value() < 0 || static_cast<uint64_t>(length.value()) > literal.size() + 1) {
+        return {};
+    }
+    return std::string(literal.c_str(), length.value());
+}
+
+std::optional<int64_t> ConstantFolder::knownInt(const VReg reg) const {
+    if (known(reg).kind != Known::Kind::Int) {
+        return {};
+    }
+    return known(reg).value;
+}
+
+void ConstantFolder::removeUnusedConstants(IRFunction& function) {
+    // dropping one constant can leave nothing reading another only through a copy, so repeat until stable
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<uint32_t> uses(function.types.size(), 0);
+        for (const IRBlock& block : function.blocks) {
+            for (const IRInst& inst : block.insts) {
+                function.forEachUse(inst, [&](const VReg reg) { uses[reg]++; });
+            }
+        }
+
+        for (IRBlock& block : function.blocks) {
+            std::erase_if(block.insts, [&](const IRInst& inst) {
+                const bool unused = (inst.op == IROp::Const || inst.op == IROp::StrAddr || inst.op == IROp::Copy)
+                    && uses[inst.dst] == 0;
+                changed |= unused;
+                return unused;
+            });
+        }
+    }
+}
@@ -0,0 +1,263 @@
+#include "DeadCodeEliminator.hpp"
+
+#include <algorithm>
+
+DeadCodeEliminator::DeadCodeEliminator(IRModule& module) : m_Module(module) {
+
+}
+
+void DeadCodeEliminator::run() {
+    for (IRFunction& function : m_Module.functions) {
+        m_Function = &function;
+        countDefs();
+        foldBranches();
+        removeUnreachable();
+
+        bool changed = true;
+        while (changed) {
+            countDefs();
+            changed = removeDeadStores();
+            countDefs();
+            changed |= removeUnused();
+        }
+    }
+}
+
+void DeadCodeEliminator::foldBranches() {
+    for (IRBlock& block : m_Function->blocks) {
+        IRInst& last = block.insts.back();
+        if (last.op != IROp::Br) {
+            continue;
+        }
+        const IRInst* cond = m_SingleDef[last.a];
+        if (cond != nullptr && cond->op == IROp::Const) {
+            last = IRInst{ .op = IROp::Jmp, .target = cond->imm != 0 ? last.target : last.elseTarget };
+        } else if (last.target == last.elseTarget) {
+            last = IRInst{ .op = IROp::Jmp, .target = last.target };
+        }
+    }
+}
+
+void DeadCodeEliminator::removeUnreachable() {
+    const std::vector<IRBlock>& blocks = m_Function->blocks;
+    std::vector<bool> reached(blocks.size(), false);
+    std::vector<uint32_t> worklist = { 0 };
+    reached[0] = true;
+    while (!worklist.empty()) {
+        const IRInst& last = blocks[worklist.back()].insts.back();
+        worklist.pop_back();
+        if (last.op != IROp::Jmp && last.op != IROp::Br) {
+            continue;
+        }
+        for (const uint32_t target : { last.target, last.op == IROp::Br ? last.elseTarget : last.target }) {
+            if (!reached[target]) {
+                reached[target] = true;
+                worklist.push_back(target);
+            }
+        }
+    }
+
+    // keep the layout of what is left
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        if (reached[b]) {
+            order.push_back(b);
+        }
+    }
+    if (order.size() != blocks.size()) {
+        m_Function->reorderBlocks(order);
+    }
+}
+
+bool DeadCodeEliminator::removeDeadStores() {
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+    std::vector<std::vector<uint32_t>> preds(blocks.size());
+    std::vector<std::vector<uint32_t>> succs(blocks.size());
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        const IRInst& last = blocks[b].insts.back();
+        if (last.op == IROp::Jmp || last.op == IROp::Br) {
+            succs[b].push_back(last.target);
+        }
+        if (last.op == IROp::Br && last.elseTarget != last.target) {
+            succs[b].push_back(last.elseTarget);
+        }
+        for (const uint32_t succ : succs[b]) {
+            preds[succ].push_back(b);
+        }
+    }
+
+    // (vreg, block) pairs for registers written more than once: blocks reading one before writing it,
+    // and blocks writing it. registers written once are left to removeUnused
+    std::vector<std::pair<VReg, uint32_t>> upwardUses;
+    std::vector<std::pair<VReg, uint32_t>> defs;
+    std::vector<uint32_t> defStamp(m_DefCount.size(), UINT32_MAX);
+    std::vector<uint32_t> useStamp(m_DefCount.size(), UINT32_MAX);
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        for (const IRInst& inst : blocks[b].insts) {
+            m_Function->forEachUse(inst, [&](const VReg reg) {
+                if (m_DefCount[reg] > 1 && defStamp[reg] != b && useStamp[reg] != b) {
+                    useStamp[reg] = b;
+                    upwardUses.emplace_back(reg, b);
+                }
+            });
+            if (inst.dst != NoVReg && m_DefCount[inst.dst] > 1 && defStamp[inst.dst] != b) {
+                defStamp[inst.dst] = b;
+                defs.emplace_back(inst.dst, b);
+            }
+        }
+    }
+    std::sort(upwardUses.begin(), upwardUses.end());
+    std::sort(defs.begin(), defs.end());
+
+    std::vector<uint32_t> liveIn(blocks.size(), UINT32_MAX);
+    std::vector<uint32_t> defines(blocks.size(), UINT32_MAX);
+    std::vector<uint32_t> worklist;
+    std::vector<InstRef> dead;
+    size_t u = 0;
+    for (size_t d = 0; d < defs.size();) {
+        const VReg v = defs[d].first;
+        size_t end = d;
+        for (; end < defs.size() && defs[end].first == v; end++) {
+            defines[defs[end].second] = v;
+        }
+
+        // walk back from every upward exposed use, through blocks that do not write v
+        while (u < upwardUses.size() && upwardUses[u].first < v) {
+            u++;
+        }
+        for (; u < upwardUses.size() && upwardUses[u].first == v; u++) {
+            worklist.push_back(upwardUses[u].second);
+        }
+        while (!worklist.empty()) {
+            const uint32_t b = worklist.back();
+            worklist.pop_back();
+            if (liveIn[b] == v) {
+                continue;
+            }
+            liveIn[b] = v;
+            for (const uint32_t pred : preds[b]) {
+                if (defines[pred] != v) {
+                    worklist.push_back(pred);
+                }
+            }
+        }
+
+        // inside every writing block: a definition no read follows before the next one or the block's end
+        for (; d < end; d++) {
+            const uint32_t b = defs[d].second;
+            bool live = std::ranges::any_of(succs[b], [&](const uint32_t succ) { return liveIn[succ] == v; });
+            const std::vector<IRInst>& insts = blocks[b].insts;
+            for (size_t i = insts.size(); i-- > 0;) {
+                const IRInst& inst = insts[i];
+                if (inst.dst == v) {
+                    if (!live && !hasSideEffects(inst)) {
+                        dead.push_back({ b, static_cast<uint32_t>(i) });
+                    }
+                    live = false;
+                }
+                m_Function->forEachUse(inst, [&](const VReg reg) { live |= reg == v; });
+            }
+        }
+    }
+
+    // erase from the back so the indices of a block stay valid
+    std::sort(dead.begin(), dead.end(), [](const InstRef& a, const InstRef& b) {
+        return a.block != b.block ? a.block < b.block : a.index > b.index;
+    });
+    for (const InstRef& ref : dead) {
+        blocks[ref.block].insts.erase(blocks[ref.block].insts.begin() + ref.index);
+    }
+    return !dead.empty();
+}
+
+bool DeadCodeEliminator::removeUnused() {
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+
+    // every definition of each register, grouped by register
+    std::vector<uint32_t> first(m_DefCount.size() + 1, 0);
+    for (size_t v = 0; v < m_DefCount.size(); v++) {
+        first[v + 1] = first[v] + m_DefCount[v];
+    }
+    std::vector<InstRef> defsOf(first.back());
+    std::vector<uint32_t> filled(first.begin(), first.end() - 1);
+    std::vector<std::vector<bool>> live(blocks.size());
+    std::vector<InstRef> worklist;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        live[b].assign(blocks[b].insts.size(), false);
+        for (uint32_t i = 0; i < blocks[b].insts.size(); i++) {
+            const IRInst& inst = blocks[b].insts[i];
+            for (const VReg reg : { inst.dst, inst.dst2 }) {
+                if (reg != NoVReg) {
+                    defsOf[filled[reg]++] = { b, i };
+                }
+            }
+            if (hasSideEffects(inst)) {
+                live[b][i] = true;
+                worklist.push_back({ b, i });
+            }
+        }
+    }
+
+    while (!worklist.empty()) {
+        const InstRef ref = worklist.back();
+        worklist.pop_back();
+        m_Function->forEachUse(blocks[ref.block].insts[ref.index], [&](const VReg reg) {
+            for (uint32_t k = first[reg]; k < first[reg + 1]; k++) {
+                const InstRef def = defsOf[k];
+                if (!live[def.block][def.index]) {
+                    live[def.block][def.index] = true;
+                    worklist.push_back(def);
+                }
+            }
+        });
+    }
+
+    bool changed = false;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        std::vector<IRInst>& insts = blocks[b].insts;
+        size_t kept = 0;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (live[b][i]) {
+                insts[kept++] = insts[i];
+            }
+        }
+        changed |= kept != insts.size();
+        insts.resize(kept);
+    }
+    return changed;
+}
+
+bool DeadCodeEliminator::hasSideEffects(const IRInst& inst) const {
+    switch (inst.op) {
+        case IROp::Write:
+        case IROp::Call: // thingies can yell or exit
+            return true;
+        case IROp::Div: {
+            // a division by zero has to trap
+            const IRInst* divisor = m_SingleDef[inst.b];
+            return divisor == nullptr || divisor->op != IROp::Const || divisor->imm == 0;
+        }
+        default:
+            return isTerminator(inst.op);
+    }
+}
+
+void DeadCodeEliminator::countDefs() {
+    m_DefCount.assign(m_Function->types.size(), 0);
+    m_SingleDef.assign(m_Function->types.size(), nullptr);
+    for (const IRBlock& block : m_Function->blocks) {
+        for (const IRInst& inst : block.insts) {
+            for (const VReg reg : { inst.dst, inst.dst2 }) {
+                if (reg != NoVReg) {
+                    m_DefCount[reg]++;
+                    m_SingleDef[reg] = &inst;
+                }
+            }
+        }
+    }
+    for (size_t v = 0; v < m_DefCount.size(); v++) {
+        if (m_DefCount[v] != 1) {
+            m_SingleDef[v] = nullptr;
+        }
+    }
+}
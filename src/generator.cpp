@@ -4,551 +4,455 @@
 #include <format>
 #include <cassert>
 
-Generator::Generator(NodeProg prog): m_Prog(std::move(prog)) {
-    m_TypeChecker = std::make_unique<TypeChecker>(m_Scopes);
-    m_OpGenerator = std::make_unique<OperationGenerator>(m_Output);
+Generator::Generator(const Ast& ast, const Interner& interner, const Annotations& annotations)
+    : m_Ast(ast), m_Interner(interner), m_Annotations(annotations) {
+    m_Vars.resize(m_Annotations.symbolTable.size());
+    m_ThingyFunctions.resize(m_Annotations.symbolTable.size());
 }
 
-void Generator::generateTerm(const NodeTerm* term) {
-    struct TermVisitor {
-        Generator& generator;
-        void operator()(const NodeTermIntLit* intLit) const {
-            generator.m_Output << "\tmov rax, " << intLit->int_lit.value.value() << "\n";
-            generator.push("rax");
-        }
-
-        void operator()(const NodeTermBool* _bool) const {
-            generator.m_Output << "\tmov rax, " << _bool->_bool.value.value() << "\n";
-            generator.push("rax");
-        }
-
-        void operator()(const NodeTermIdent* ident) const {
-            const Var* var = generator.lookupVar(ident->ident.value.value());
-            generator.generateVariableLoad(var);
-        }
-
-        void operator()(const NodeTermString* string) const {
-            const auto label = generator.findStringLiteral(string->string.value.value());
+Value Generator::generateTerm(const NodeIndex term) {
+    switch (m_Ast.kind(term)) {
+        case NodeKind::IntLit:
+            return { builder().constant(static_cast<int64_t>(m_Ast.intValue(term))) };
 
-            generator.m_Output << "\tlea rax, [rel " << label << "]\n";
-            generator.push("rax");
+        case NodeKind::Bool:
+            return { builder().constant(m_Ast.lhs(term), IRType::Bool) };
 
-            generator.m_Output << "\tmov rax, "<< label << "_len\n";
-            generator.push("rax");
-        }
+        case NodeKind::Ident:
+            return lookupVar(term);
 
-        void operator()(const NodeTermParen* paren) const {
-            generator.generateExpr(paren->expr);
+        case NodeKind::String: {
+            const uint32_t literal = findStringLiteral(m_Ast.string(term));
+            const VReg ptr = fn().newVReg(IRType::Ptr);
+            builder().emit(IRInst{ .op = IROp::StrAddr, .dst = ptr, .imm = literal });
+            // the length counts the terminating NUL
+            return { ptr, builder().constant(static_cast<int64_t>(m_Module.strings[literal].size() + 1)) };
         }
 
-        void operator()(const NodeTermCall* call) const {
-            for(auto it = call->args.rbegin(); it != call->args.rend(); ++it) {
-                generator.generateExpr(*it);
-            }
-
-            const Thingy* thingy = generator.lookupThingy(call->ident.value.value());
-            generator.m_Output << "\tcall " << thingy->label << "\n";
-
-            size_t totalParamSize = 0;
-            for(VarType paramType : thingy->paramTypes) {
-                totalParamSize += (paramType == VarType::String) ? 16 : 8;
+        case NodeKind::Call: {
+            // arguments are evaluated right to left, a string passes its pointer then its length
+            const std::span<const NodeIndex> args = m_Ast.list(term);
+            std::vector<Value> values(args.size());
+            for (size_t i = args.size(); i-- > 0;) {
+                values[i] = generateExpr(args[i]);
             }
-            if (totalParamSize > 0) {
-                generator.m_Output << "\tadd rsp, " << totalParamSize << "\n";
-                generator.m_StackSize -= totalParamSize;
+            std::vector<VReg> operands;
+            for (size_t i = 0; i < args.size(); i++) {
+                operands.push_back(values[i].reg);
+                if (m_Annotations.type(args[i]) == VarType::String) {
+                    operands.push_back(values[i].len);
+                }
             }
 
-            generator.push("rax");
+            const VarType type = m_Annotations.type(term);
+            Value result{ fn().newVReg(irType(type)) };
+            if (type == VarType::String) {
+                result.len = fn().newVReg(IRType::Int);
+            }
+            builder().emit(IRInst{
+                .op = IROp::Call,
+                .dst = result.reg,
+                .dst2 = result.len,
+                .imm = m_ThingyFunctions[m_Annotations.symbolId(term)],
+                .argBegin = fn().addArgs(operands),
+                .argCount = static_cast<uint32_t>(operands.size()),
+            });
+            return result;
         }
-    };
 
-    TermVisitor visitor({ .generator = *this });
-    std::visit(visitor, term->var);
+        default:
+            error("Expected a term");
+            return {};
+    }
 }
 
-void Generator::generateBinExpr(const NodeBinExpr* binExpr) {
-    const TypeInfo leftType = m_TypeChecker->checkExpr(binExpr->left);
-    const TypeInfo rightType = m_TypeChecker->checkExpr(binExpr->right);
-    const TypeInfo resultType = m_TypeChecker->checkBinExpr(binExpr);
-
-    generateExpr(binExpr->right);
-    generateExpr(binExpr->left);
-
-    if (leftType.type == VarType::String) {
-        pop("rax"); // len
-        pop("rdx"); // ptr
-    } else {
-        pop("rax");
+Value Generator::generateBinExpr(const NodeIndex binExpr) {
+    const NodeIndex left = m_Ast.lhs(binExpr);
+    const NodeIndex right = m_Ast.rhs(binExpr);
+    const BinOp op = m_Ast.binOp(binExpr);
+    const VarType leftType = m_Annotations.type(left);
+    const VarType rightType = m_Annotations.type(right);
+    if (op == BinOp::And || op == BinOp::Or) {
+        return generateLogical(binExpr);
     }
 
-    if (rightType.type == VarType::String) {
-        pop("rbx"); // len
-        pop("rcx"); // ptr
-    } else {
-        pop("rbx");
-    }
+    const Value rightValue = generateExpr(right);
+    const Value leftValue = generateExpr(left);
 
-    switch (binExpr->op)
+    switch (op)
     {
         case BinOp::Add:
         case BinOp::Sub:
         case BinOp::Mul:
         case BinOp::Div:
-            m_OpGenerator->generateArithmetic(binExpr->op, leftType.type, rightType.type);
-            break;
+            return m_OpGenerator.generateArithmetic(op, leftType, rightType, leftValue, rightValue);
         case BinOp::Eq:
         case BinOp::Neq:
         case BinOp::Lt:
         case BinOp::Le:
         case BinOp::Gt:
         case BinOp::Ge:
-            m_OpGenerator->generateComparison(binExpr->op, leftType.type, rightType.type);
-            break;
-        case BinOp::And:
-        case BinOp::Or:
-            m_OpGenerator->generateLogical(binExpr->op, leftType.type, rightType.type);
-            break;
+            return m_OpGenerator.generateComparison(op, leftType, rightType, leftValue, rightValue);
 
         case BinOp::Band:
         case BinOp::Bor:
         case BinOp::Xor:
-            m_OpGenerator->generateBitwise(binExpr->op, leftType.type, rightType.type);
-            break;
-        
+            return m_OpGenerator.generateBitwise(op, leftValue, rightValue);
+
         default:
             error("Unknown Binary Operator");
-    }
-    
-    // for string results, push both pointer and length
-    if (resultType.type == VarType::String) {
-        push("rdx"); // ptr
-        push("rax"); // len
-    } else {
-        push("rax");
+            return {};
     }
 }
 
-void Generator::generateExpr(const NodeExpr* expr) {
-    const TypeInfo typeInfo = m_TypeChecker->checkExpr(expr);
-    if (!typeInfo.isValid) {
-        error(typeInfo.errorMsg);
+Value Generator::generateExpr(const NodeIndex expr) {
+    if (m_Ast.kind(expr) == NodeKind::BinExpr) {
+        return generateBinExpr(expr);
     }
-
-    struct ExprVisitor {
-        Generator& generator;
-        void operator()(const NodeTerm* term) const {
-            generator.generateTerm(term);
-        }
-
-        void operator()(const NodeBinExpr* binExpr) const {
-            generator.generateBinExpr(binExpr);
-        }
-    };
-
-    ExprVisitor visitor({ .generator = *this });
-    std::visit(visitor, expr->var);
+    return generateTerm(expr);
 }
 
-void Generator::generateScope(const NodeScope* scope) {
-    enterScope();
-            
-    for(const NodeStmt* stmt : scope->stmts) {
+void Generator::generateScope(const NodeIndex scope) {
+    for(const NodeIndex stmt : m_Ast.list(scope)) {
         generateStmt(stmt);
     }
-
-    leaveScope();
-}
-
-void Generator::generateMaybePred(const NodeMaybePred* pred, const std::string& endLabel) {
-    struct PredVisitor {
-        Generator& generator;
-        const std::string& endLabel;
-        void operator()(const NodeMaybePredBut* but) const {
-            generator.generateExpr(but->expr);
-            generator.pop("rax");
-
-            const std::string label = generator.createLabel("maybe_pred");
-
-            generator.m_Output << "\tcmp rax, 0\n";
-            generator.m_Output << "\tjz " << label << "\n";
-            generator.generateScope(but->scope);
-            generator.m_Output << "\tjmp " << endLabel << "\n";
-            if (but->pred.has_value()) {
-                generator.m_Output << label << ":\n";
-                generator.generateMaybePred(but->pred.value(), endLabel);
-            }
-        }
-
-        void operator()(const NodeMaybePredNah* nah) const {
-            generator.generateScope(nah->scope);
-        }
-    };
-    PredVisitor visitor({ .generator = *this, .endLabel = endLabel });
-    std::visit(visitor, pred->var);
 }
 
-void Generator::generateThingy(const NodeStmtThingy* stmtThingy) {
-    std::vector<VarType> params;
-    for (const NodeParam* param : stmtThingy->params) {
-        params.push_back(tokenTypeToVarType(param->type->type));
+void Generator::generateMaybePred(const NodeIndex pred, const uint32_t endBlock) {
+    if (m_Ast.kind(pred) == NodeKind::Nah) {
+        generateScope(m_Ast.lhs(pred));
+        return;
     }
 
-    VarType returnType = tokenTypeToVarType(stmtThingy->returnType->type);
-    const Thingy thingy {.paramTypes = params, .returnType = returnType, .label = createLabel(stmtThingy->name.value.value()) };
-
-    declareThingy(stmtThingy->name.value.value(), thingy);
-
-    m_Output << thingy.label << ":\n";
-
-    // function prologue
-    m_Output << "\tpush rbp\n";
-    m_Output << "\tmov rbp, rsp\n";
+    const Ast::Branch but = m_Ast.branch(pred);
+    const uint32_t next = createBlock("maybe_pred");
 
-    enterScope();
+    generateBranch(but.cond, next);
+    generateScope(but.scope);
+    builder().jump(endBlock);
+    builder().startBlock(next);
+    if (but.pred != NoNode) {
+        generateMaybePred(but.pred, endBlock);
+    }
+}
 
-    size_t currentParamOffset = 16;
-    for(size_t i = 0; i < stmtThingy->params.size(); i++) {
-        const NodeParam* param = stmtThingy->params[i];
-        VarType paramType = tokenTypeToVarType(param->type->type);
+void Generator::generateThingy(const NodeIndex stmtThingy) {
+    const Ast::Proto proto = m_Ast.proto(stmtThingy);
+    const VarType returnType = tokenTypeToVarType(proto.returnType);
+
+    // thingies nested in a body become functions of their own
+    m_ThingyFunctions[m_Annotations.symbolId(stmtThingy)] = static_cast<uint32_t>(m_Module.functions.size());
+    const std::string name(m_Interner.name(m_Ast.name(stmtThingy)));
+    m_Module.functions.push_back(IRFunction{
+        .name = createLabel(name),
+        .sourceName = name,
+        .returnCount = static_cast<uint8_t>(returnType == VarType::String ? 2 : 1),
+    });
+    IRBuilder thingyBuilder(m_Module, m_Module.functions.size() - 1, createLabel("entry"));
+    IRBuilder* outer = switchBuilder(&thingyBuilder);
+
+    for(const NodeIndex param : proto.params) {
+        const Value var = declareVar(param);
+        builder().emit(IRInst{ .op = IROp::Param, .dst = var.reg, .imm = fn().paramSlots++ });
+        if (var.len != NoVReg) {
+            builder().emit(IRInst{ .op = IROp::Param, .dst = var.len, .imm = fn().paramSlots++ });
+        }
+    }
 
-        declareParam(param->name.value.value(), paramType, currentParamOffset);
+    generateScope(proto.scope);
 
-        size_t paramSize = (paramType == VarType::String) ? 16 : 8;
-        currentParamOffset += paramSize;
+    // falling off the end returns zero
+    Value zero{ builder().constant(0, irType(returnType)) };
+    if (returnType == VarType::String) {
+        zero.len = builder().constant(0);
     }
+    generateReturn(zero, returnType);
 
-    generateScope(stmtThingy->scope);
-
-    leaveScope();
-    m_Output << "\tpop rbp\n";
-    m_Output << "\tret\n";
+    thingyBuilder.finish();
+    switchBuilder(outer);
 }
 
-void Generator::generateStmt(const NodeStmt* stmt) {
-    struct StmtVisitor {
-        Generator& generator;
-        void operator()(const NodeStmtBye* bye) const {
-            // check that the expression is a number
-            const TypeInfo exprType = generator.m_TypeChecker->checkExpr(bye->expr);
-            if (!exprType.isValid) {
-                error(exprType.errorMsg);
-            }
-            if (exprType.type != VarType::Number) {
-                error(std::format("bye() requires a number argument, got {}", getTypeName(exprType.type)));
-            }
+void Generator::generateStmt(const NodeIndex stmt) {
+    switch (m_Ast.kind(stmt)) {
+        case NodeKind::Bye:
+            builder().emit(IRInst{ .op = IROp::Exit, .a = generateExpr(m_Ast.lhs(stmt)).reg });
+            break;
 
-            generator.generateExpr(bye->expr);
-            generator.m_Output << "\tmov rax, 60\n";
-            generator.pop("rdi");
-            generator.m_Output << "\tsyscall\n";
+        case NodeKind::Gimme: {
+            const Value var = declareVar(stmt);
+            assign(var, generateExpr(m_Ast.lhs(stmt)));
+            break;
         }
 
-        void operator()(const NodeStmtGimme* gimme) const {
-            // Get the type from the type annotation
-            VarType declaredType = tokenTypeToVarType(gimme->type->type);
-            
-            // Check expression type matches declared type
-            const TypeInfo exprType = generator.m_TypeChecker->checkExpr(gimme->expr);
-            if (!exprType.isValid) {
-                error(exprType.errorMsg);
-            }
-            if (exprType.type != declaredType) {
-                error(std::format("Type mismatch in variable declaration '{}'. Expected {}, got {}", 
-                    gimme->ident.value.value(), getTypeName(declaredType), getTypeName(exprType.type)));
-            }
-
-            generator.declareVar(gimme->ident.value.value(), declaredType);
-            generator.generateExpr(gimme->expr);
-
-            const Var* var = generator.lookupVar(gimme->ident.value.value());
-            generator.generateVariableStore(var);
-        }
+        case NodeKind::Assignment:
+            assign(lookupVar(stmt), generateExpr(m_Ast.lhs(stmt)));
+            break;
 
-        void operator()(const NodeStmtAssignment* assignment) const {
-            const Var* var = generator.lookupVar(assignment->ident.value.value());
-            const TypeInfo exprType = generator.m_TypeChecker->checkExpr(assignment->expr);
-            
-            if (!exprType.isValid) {
-                error(exprType.errorMsg);
-            }
-            if (exprType.type != var->type) {
-                error(std::format("Type mismatch in assignment to '{}'. Expected {}, got {}", 
-                    assignment->ident.value.value(), getTypeName(var->type), getTypeName(exprType.type)));
-            }
+        case NodeKind::Scope:
+            generateScope(stmt);
+            break;
 
-            generator.generateExpr(assignment->expr);
-            generator.generateVariableStore(var);
-        }
+        case NodeKind::Maybe: {
+            const Ast::Branch maybe = m_Ast.branch(stmt);
+            const uint32_t next = createBlock("maybe");
 
-        void operator()(const NodeScope* scope) const {
-            generator.generateScope(scope);
-        }
+            generateBranch(maybe.cond, next);
+            generateScope(maybe.scope);
 
-        void operator()(const NodeStmtMaybe* maybe) const {
-            generator.generateExpr(maybe->expr);
-            generator.pop("rax");
-
-            const std::string label = generator.createLabel("maybe");
-
-            generator.m_Output << "\tcmp rax, 0\n";
-            generator.m_Output << "\tjz " << label << "\n";
-            generator.generateScope(maybe->scope);
-                
-            
-            if(maybe->pred.has_value()) {
-                const std::string& endLabel = generator.createLabel("maybe_pred");
-                generator.m_Output << "\tjmp " << endLabel << "\n";
-                generator.m_Output << label << ":\n";
-                generator.generateMaybePred(maybe->pred.value(), endLabel);
-                generator.m_Output << endLabel << ":\n";
+            if(maybe.pred != NoNode) {
+                const uint32_t endBlock = createBlock("maybe_end");
+                builder().jump(endBlock);
+                builder().startBlock(next);
+                generateMaybePred(maybe.pred, endBlock);
+                builder().startBlock(endBlock);
             } else {
-                generator.m_Output << label << ":\n";
-            }
-        }
-
-        void operator()(const NodeStmtYell* yell) const {
-            // check that the expression is a string
-            const TypeInfo exprType = generator.m_TypeChecker->checkExpr(yell->expr);
-            if (!exprType.isValid) {
-                error(exprType.errorMsg);
-            }
-            if (exprType.type != VarType::String) {
-                error(std::format("yell() requires a string argument, got {}", getTypeName(exprType.type)));
+                builder().startBlock(next);
             }
-
-            generator.generateExpr(yell->expr);
-
-            generator.m_Output << "\tmov rax, 1\n";
-            generator.m_Output << "\tmov rdi, 1\n";
-            generator.pop("rdx"); // len
-            generator.pop("rsi"); // ptr
-            generator.m_Output << "\tsyscall\n";
+            break;
         }
 
-        void operator()(const NodeStmtThingy* thingy) const {
-            generator.generateThingy(thingy);
+        case NodeKind::Yell: {
+            const Value str = generateExpr(m_Ast.lhs(stmt));
+            builder().emit(IRInst{ .op = IROp::Write, .a = str.reg, .b = str.len });
+            break;
         }
 
-        void operator()(const NodeStmtGimmeback* gimmeback) const {
-            generator.generateExpr(gimmeback->expr);
-            generator.pop("rax");
-
-            const Scope& currentScope = generator.m_Scopes.back();
-            size_t cleanupSize = generator.m_StackSize - currentScope.stackStart;
-            if (cleanupSize > 0) {
-                generator.m_Output << "\tadd rsp, " << cleanupSize << "\n";
-            }
-            generator.m_Output << "\tpop rbp\n";
+        case NodeKind::Thingy:
+            generateThingy(stmt);
+            break;
 
-            generator.m_Output << "\tret\n";
+        case NodeKind::Gimmeback: {
+            const NodeIndex expr = m_Ast.lhs(stmt);
+            generateReturn(generateExpr(expr), m_Annotations.type(expr));
+            break;
         }
 
-        void operator()(const NodeStmtFour* four) const {
-            generator.enterScope();
-            
-            generator.declareVar(four->ident.value.value(), VarType::Number);
-            const Var* var = generator.lookupVar(four->ident.value.value());
-
-            generator.generateExpr(four->start);
-            generator.generateVariableStore(var);
-
-            const std::string startLabel = generator.createLabel("loop_start");
-            const std::string endLabel = generator.createLabel("loop_end");
-
-            generator.m_Output << startLabel << ":\n";
-
-            generator.generateExpr(four->end);
-            generator.pop("rax");
-            generator.m_Output << "\tcmp rax, [rbp - " << var->stackLoc << "]\n";
-            generator.m_Output << "\tjle " << endLabel << "\n";
-
-            generator.generateScope(four->scope);
-
-            generator.m_Output << "\tadd qword [rbp - " << var->stackLoc << "], 1\n";
-            generator.m_Output << "\tjmp " << startLabel << "\n";
-            generator.m_Output << endLabel << ":\n";
-
-            generator.leaveScope();
+        case NodeKind::Four: {
+            const Ast::Loop four = m_Ast.loop(stmt);
+            const Value var = declareVar(stmt);
+            assign(var, generateExpr(four.start));
+
+            const uint32_t startBlock = createBlock("loop_start");
+            const uint32_t bodyBlock = createBlock("loop_body");
+            const uint32_t endBlock = createBlock("loop_end");
+
+            // the bound is evaluated again on every iteration
+            builder().startBlock(startBlock);
+            const Value end = generateExpr(four.end);
+            const VReg more = fn().newVReg(IRType::Bool);
+            builder().emit(IRInst{ .op = IROp::Cmp, .cmp = CmpOp::Gt, .dst = more, .a = end.reg, .b = var.reg });
+            builder().branch(more, bodyBlock, endBlock);
+
+            builder().startBlock(bodyBlock);
+            generateScope(four.scope);
+
+            const VReg one = builder().constant(1);
+            builder().emit(IRInst{ .op = IROp::Add, .dst = var.reg, .a = var.reg, .b = one });
+            builder().jump(startBlock);
+            builder().startBlock(endBlock);
+            break;
         }
 
-        void operator()(const NodeStmtWhy* why) const {
-            const std::string startLabel = generator.createLabel("why_start");
-            const std::string endLabel = generator.createLabel("why_end");
+        case NodeKind::Why: {
+            const uint32_t startBlock = createBlock("why_start");
+            const uint32_t endBlock = createBlock("why_end");
 
-            generator.m_Output << startLabel << ":\n";
+            builder().startBlock(startBlock);
+            generateBranch(m_Ast.lhs(stmt), endBlock);
+            generateScope(m_Ast.rhs(stmt));
 
-            generator.generateExpr(why->expr);
-            generator.pop("rax");
-            
-            generator.m_Output << "\tcmp rax, 0\n";
-            generator.m_Output << "\tjz " << endLabel << "\n";
-
-            generator.generateScope(why->scope);
-
-            generator.m_Output << "\tjmp " << startLabel << "\n";
-            generator.m_Output << endLabel << ":\n";
+            builder().jump(startBlock);
+            builder().startBlock(endBlock);
+            break;
         }
-    };
-    StmtVisitor visitor({ .generator = *this });
-    std::visit(visitor, stmt->var);
-}
 
-std::string Generator::generateProg() {
-    m_Output << "section .text\n";
-    m_Output << "\tglobal _start\n";
-    m_Output << "\textern __whacky_strcat\n";
-    m_Output << "\textern __whacky_strmul\n\n";
+        default:
+            error("Expected a statement");
+    }
+}
 
-    m_Data << "section .data\n";
-    
-    enterScope();
+IRModule Generator::generateProg() {
+    const std::span<const NodeIndex> stmts = m_Ast.list(m_Ast.root());
     // generate all thingy definitions
-    for(const NodeStmt* stmt : m_Prog.stmts) {
-        if (auto* stmtVar = std::get_if<NodeStmtThingy*>(&stmt->var)) {
-            generateThingy(*stmtVar);
+    for(const NodeIndex stmt : stmts) {
+        if (m_Ast.kind(stmt) == NodeKind::Thingy) {
+            generateThingy(stmt);
         }
     }
-    
-    m_Output << "_start:\n";
-    m_Output << "\tpush rbp\n";
-    m_Output << "\tmov rbp, rsp\n";
-    
-    for(const NodeStmt* stmt : m_Prog.stmts) {
+
+    m_Module.functions.push_back(IRFunction{ .name = "_start", .isEntry = true });
+    IRBuilder startBuilder(m_Module, m_Module.functions.size() - 1, createLabel("entry"));
+    switchBuilder(&startBuilder);
+
+    for(const NodeIndex stmt : stmts) {
         // skip thingies
-        if (std::holds_alternative<NodeStmtThingy*>(stmt->var)) {
+        if (m_Ast.kind(stmt) == NodeKind::Thingy) {
             continue;
         }
         generateStmt(stmt);
     }
 
-    leaveScope();
-
-    m_Output << "\tpop rbp\n";
-    m_Output << "\tmov rax, 60\n";
-    m_Output << "\tmov rdi, 0\n";
-    m_Output << "\tsyscall";
-    
-    return m_Data.str() + m_Output.str();
-}
+    builder().emit(IRInst{ .op = IROp::Exit, .a = builder().constant(0) });
+    startBuilder.finish();
+    switchBuilder(nullptr);
 
-void Generator::push(const std::string& reg, size_t size /*=8*/) {
-    m_Output << "\tpush " << reg << "\n";
-    m_StackSize += size;
+    return std::move(m_Module);
 }
 
-void Generator::pop(const std::string& reg, size_t size /*=8*/) {
-    m_Output << "\tpop " << reg << "\n";
-    m_StackSize -= size;
+IRBuilder* Generator::switchBuilder(IRBuilder* builder) {
+    IRBuilder* outer = m_Builder;
+    m_Builder = builder;
+    if (builder != nullptr) {
+        m_OpGenerator.setBuilder(*builder);
+    }
+    return outer;
 }
 
-
-void Generator::enterScope() {
-    m_Scopes.emplace_back(Scope{{}, {}, m_StackSize});
+Value Generator::declareVar(const NodeIndex decl) {
+    const VarType type = m_Annotations.type(decl);
+    Value& var = m_Vars[m_Annotations.symbolId(decl)];
+    var.reg = fn().newVReg(irType(type));
+    var.len = (type == VarType::String) ? fn().newVReg(IRType::Int) : NoVReg;
+    return var;
 }
 
-void Generator::leaveScope() {
-    const Scope scope = m_Scopes.back();
-    m_Scopes.pop_back();
-    
-    const size_t popCount = m_StackSize - scope.stackStart;
-    if (popCount > 0) {
-        m_Output << "\tadd rsp, " << popCount << "\n";
-        m_StackSize = scope.stackStart;
+void Generator::assign(const Value& var, const Value& value) {
+    builder().emit(IRInst{ .op = IROp::Copy, .dst = var.reg, .a = value.reg });
+    if (var.len != NoVReg) {
+        builder().emit(IRInst{ .op = IROp::Copy, .dst = var.len, .a = value.len });
     }
 }
 
-Var* Generator::lookupVar(const std::string& name) {    
-    for (auto it = m_Scopes.rbegin(); it != m_Scopes.rend(); ++it) {
-        auto found = it->vars.find(name);
-        if(found != it->vars.end()) {
-            return &found->second;
-        }
+void Generator::generateBranch(const NodeIndex cond, const uint32_t falseBlock) {
+    if (!isCondition(cond)) {
+        const Value value = generateExpr(cond);
+        const uint32_t trueBlock = createBlock("then");
+        builder().branch(value.reg, trueBlock, falseBlock);
+        builder().startBlock(trueBlock);
+        return;
     }
 
-    error("Undeclared identifier: " + name);
-    return nullptr;
+    // comparisons and logical operators jump straight to where they lead instead of producing a boolean
+    const uint32_t trueBlock = createBlock("then");
+    generateCondition(cond, trueBlock, falseBlock);
+    builder().startBlock(trueBlock);
 }
 
-void Generator::declareVar(const std::string& name, VarType type) {
-    auto& currentScope = m_Scopes.back().vars;
-    if (currentScope.contains(name)) {
-        error("Identifier already declared in this scope: " + name);
+bool Generator::isCondition(const NodeIndex expr) const {
+    if (m_Ast.kind(expr) != NodeKind::BinExpr) {
+        return false;
     }
-    size_t size = 8;
-    if (type == VarType::String) {
-        size = 16;
+    switch (m_Ast.binOp(expr)) {
+        case BinOp::Eq: case BinOp::Neq: case BinOp::Lt: case BinOp::Le: case BinOp::Gt: case BinOp::Ge:
+        case BinOp::And: case BinOp::Or:
+            return true;
+        default:
+            return false;
     }
-
-    m_Output << "\tsub rsp, " << size << "\n";
-    m_StackSize += size;
-
-    currentScope.insert({ name, Var{ .size = size, .type = type, .stackLoc = m_StackSize, .isParam = false } });
 }
 
-void Generator::declareParam(const std::string& name, VarType type, size_t paramOffset) {
-    auto& currentScope = m_Scopes.back().vars;
-    if (currentScope.contains(name)) {
-        error("Parameter already declared: " + name);
+void Generator::generateCondition(const NodeIndex expr, const uint32_t trueBlock, const uint32_t falseBlock) {
+    if (!isCondition(expr)) {
+        const VReg value = OperationGenerator::scalar(generateExpr(expr), m_Annotations.type(expr));
+        builder().branch(value, trueBlock, falseBlock);
+        return;
     }
 
-    size_t size = 8;
-    if (type == VarType::String) {
-        size = 16;
+    const NodeIndex left = m_Ast.lhs(expr);
+    const NodeIndex right = m_Ast.rhs(expr);
+    const BinOp op = m_Ast.binOp(expr);
+    if (op == BinOp::And || op == BinOp::Or) {
+        // the left side decides alone when it is false for and, true for or
+        const uint32_t next = createBlock(op == BinOp::And ? "and" : "or");
+        if (op == BinOp::And) {
+            generateCondition(left, next, falseBlock);
+        } else {
+            generateCondition(left, trueBlock, next);
+        }
+        builder().startBlock(next);
+        generateCondition(right, trueBlock, falseBlock);
+        return;
     }
 
-    currentScope.insert({ name, Var { .size = size, .type = type, .stackLoc = paramOffset, .isParam = true } });
+    // the comparison goes right before the branch, where its flags decide the jump
+    const Value rightValue = generateExpr(right);
+    const Value leftValue = generateExpr(left);
+    const VReg flag = fn().newVReg(IRType::Bool);
+    builder().emit(IRInst{
+        .op = IROp::Cmp,
+        .cmp = OperationGenerator::comparison(op),
+        .dst = flag,
+        .a = OperationGenerator::scalar(leftValue, m_Annotations.type(left)),
+        .b = OperationGenerator::scalar(rightValue, m_Annotations.type(right)),
+    });
+    builder().branch(flag, trueBlock, falseBlock);
 }
 
-void Generator::declareThingy(const std::string& name, const Thingy& thingy) {
-    auto& currentScope = m_Scopes.back().functions;
-    if(currentScope.contains(name)) {
-        error("Function already declared in this scope: " + name);
-    }
-    currentScope.insert({ name, thingy });
+Value Generator::generateLogical(const NodeIndex binExpr) {
+    const uint32_t trueBlock = createBlock("logical_true");
+    const uint32_t falseBlock = createBlock("logical_false");
+    const uint32_t endBlock = createBlock("logical_end");
+    generateCondition(binExpr, trueBlock, falseBlock);
+
+    // written on both paths, like a variable
+    const VReg result = fn().newVReg(IRType::Bool);
+    builder().startBlock(trueBlock);
+    builder().emit(IRInst{ .op = IROp::Const, .dst = result, .imm = 1 });
+    builder().jump(endBlock);
+    builder().startBlock(falseBlock);
+    builder().emit(IRInst{ .op = IROp::Const, .dst = result, .imm = 0 });
+    builder().startBlock(endBlock);
+    return { result };
 }
-const Thingy* Generator::lookupThingy(const std::string& name) {
-    for(auto it = m_Scopes.rbegin(); it != m_Scopes.rend(); ++it) {
-        auto found = it->functions.find(name);
-        if(found != it->functions.end()) {
-            return &found->second;
-        }
+
+void Generator::generateReturn(const Value& value, const VarType type) {
+    // strings come back as pointer and length
+    if (type == VarType::String) {
+        builder().emit(IRInst{ .op = IROp::Ret, .count = 2, .a = value.reg, .b = value.len });
+    } else {
+        builder().emit(IRInst{ .op = IROp::Ret, .count = 1, .a = value.reg });
     }
-    error("Undeclared function: " + name);
-    return nullptr;
 }
 
 std::string Generator::createLabel(const std::string& name /*="label"*/) {
     return name + std::to_string(m_LabelCount++);
 }
 
-std::string Generator::findStringLiteral(const std::string& value) {
+uint32_t Generator::findStringLiteral(const std::string_view value) {
     if(m_StringLiterals.contains(value)) {
         return m_StringLiterals.at(value);
     }
 
-    std::string label = "str" + std::to_string(m_StringLiterals.size());
-    m_StringLiterals.insert({ value, label });
-
-    m_Data << std::format("\t{} db \"{}\", 0\n", label, escapeString(value));
-    m_Data << std::format("\t{}_len: equ $- {}\n", label, label);
+    const uint32_t index = m_Module.addString(unescapeString(value));
+    m_StringLiterals.insert({ value, index });
+    return index;
+}
 
-    return label;
+IRType Generator::irType(const VarType type) {
+    switch (type) {
+        case VarType::String:
+            return IRType::Ptr;
+        case VarType::Bool:
+            return IRType::Bool;
+        default:
+            return IRType::Int;
+    }
 }
 
-std::string Generator::escapeString(const std::string& input) {
+std::string Generator::unescapeString(const std::string_view input) {
     std::string out;
     for (size_t i = 0; i < input.size(); i++) {
         if (input[i] == '\\' && i + 1 < input.size()) {
             switch (input[i+1]) {
-                case 'n': out += "\", 10, \""; i++;
+                case 'n': out.push_back('\n'); i++;
                     break;
-                case 't': out += "\", 9, \""; i++;
+                case 't': out.push_back('\t'); i++;
                     break;
-                case 'r': out += "\", 13, \""; i++;
+                case 'r': out.push_back('\r'); i++;
                     break;
-                case '\\': out += "\", 92, \""; i++;
+                case '\\': out.push_back('\\'); i++;
                     break;
-                case '"': out += "\", 34, \""; i++;
+                case '"': out.push_back('"'); i++;
                     break;
                 default:
                     out.push_back(input[i]);
@@ -560,42 +464,7 @@ std::string Generator::escapeString(const std::string& input) {
     return out;
 }
 
-void Generator::generateVariableLoad(const Var* var) {
-    const char op = (var->isParam) ? '+' : '-';
-    switch (var->type) {
-        case VarType::Number:
-        case VarType::Bool:
-            push(std::format("qword [rbp {} {}]", op, var->stackLoc));
-            break;
-            
-        case VarType::String: {
-            const size_t lenOffset = var->isParam ? var->stackLoc + 8 : var->stackLoc - 8;
-            push(std::format("qword [rbp {} {}]", op, var->stackLoc));
-            push(std::format("qword [rbp {} {}]", op, lenOffset));
-            break;
-        }
-    }
-}
-
-void Generator::generateVariableStore(const Var* var) {
-    const char op = (var->isParam) ? '+' : '-';
-    switch(var->type) {
-        case VarType::Number:
-        case VarType::Bool:
-            pop("rax");
-            m_Output << std::format("\tmov [rbp {} {}], rax\n", op, var->stackLoc);
-            break;
-        case VarType::String:
-            pop("rax"); // len
-            pop("rbx"); // ptr
-            const size_t lenOffset = var->isParam ? var->stackLoc + 8 : var->stackLoc - 8;
-            m_Output << std::format("\tmov [rbp {} {}], rbx\n", op, var->stackLoc);
-            m_Output << std::format("\tmov [rbp {} {}], rax\n", op, lenOffset);
-            break;
-    }
-}
-
 void Generator::error(const std::string& msg) {
     std::cerr << "[Generator Error] " << msg << std::endl;
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
@@ -0,0 +1,296 @@
+#include "Inliner.hpp"
+
+#include <format>
+
+namespace {
+    // instructions a thingy may cost and still be copied into its callers
+    constexpr uint32_t maxInlineCost = 24;
+    // a caller stops taking in bodies once it grows this large
+    constexpr size_t maxCallerSize = 2048;
+
+    size_t size(const IRFunction& function) {
+        size_t count = 0;
+        for (const IRBlock& block : function.blocks) {
+            count += block.insts.size();
+        }
+        return count;
+    }
+
+    // gimmeback is not checked against the declared type, a thingy may hand back more or fewer registers
+    // than its callers read. the call leaves that to rax and rdx, an inlined body would not
+    bool returnsAsDeclared(const IRFunction& function) {
+        for (const IRBlock& block : function.blocks) {
+            const IRInst& last = block.insts.back();
+            if (last.op == IROp::Ret && last.count != function.returnCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> callees(const IRFunction& function) {
+        std::vector<uint32_t> called;
+        for (const IRBlock& block : function.blocks) {
+            for (const IRInst& inst : block.insts) {
+                if (inst.op == IROp::Call) {
+                    called.push_back(static_cast<uint32_t>(inst.imm));
+                }
+            }
+        }
+        return called;
+    }
+}
+
+std::string InlineStats::report() const {
+    std::string out = "inliner:\n";
+    for (const Thingy& thingy : thingies) {
+        out += std::format("  {:<24} cost {:<4} inlined {} of {} calls{}\n",
+            thingy.name, thingy.cost, thingy.inlined, thingy.calls, thingy.recursive ? ", recursive" : "");
+    }
+    out += std::format("  {:<24} {}\n", "thingies removed", removed);
+    return out;
+}
+
+Inliner::Inliner(IRModule& module, InlineStats& stats) : m_Module(module), m_Stats(stats) {
+
+}
+
+void Inliner::run() {
+    findRecursion();
+    m_Stats.thingies.clear();
+    for (uint32_t f = 0; f < m_Module.functions.size(); f++) {
+        m_Stats.thingies.push_back(InlineStats::Thingy{ .name = m_Module.functions[f].sourceName, .recursive = m_Recursive[f] });
+    }
+
+    for (const uint32_t function : bottomUpOrder()) {
+        inlineCalls(function);
+        m_Stats.thingies[function].cost = cost(m_Module.functions[function]);
+    }
+
+    // _start is no thingy
+    std::vector<InlineStats::Thingy> thingies;
+    for (uint32_t f = 0; f < m_Module.functions.size(); f++) {
+        if (!m_Module.functions[f].isEntry) {
+            thingies.push_back(std::move(m_Stats.thingies[f]));
+        }
+    }
+    m_Stats.thingies = std::move(thingies);
+    removeUnreachable();
+}
+
+void Inliner::findRecursion() {
+    const size_t count = m_Module.functions.size();
+    std::vector<std::vector<uint32_t>> calls(count);
+    for (size_t f = 0; f < count; f++) {
+        calls[f] = callees(m_Module.functions[f]);
+    }
+
+    m_Recursive.assign(count, false);
+    for (uint32_t f = 0; f < count; f++) {
+        std::vector<bool> visited(count, false);
+        std::vector<uint32_t> worklist = calls[f];
+        while (!worklist.empty() && !m_Recursive[f]) {
+            const uint32_t callee = worklist.back();
+            worklist.pop_back();
+            if (visited[callee]) {
+                continue;
+            }
+            visited[callee] = true;
+            if (callee == f) {
+                m_Recursive[f] = true;
+            }
+            worklist.insert(worklist.end(), calls[callee].begin(), calls[callee].end());
+        }
+    }
+}
+
+std::vector<uint32_t> Inliner::bottomUpOrder() const {
+    const size_t count = m_Module.functions.size();
+    std::vector<uint32_t> order;
+    std::vector<bool> visited(count, false);
+    for (uint32_t root = 0; root < count; root++) {
+        if (visited[root]) {
+            continue;
+        }
+        visited[root] = true;
+        std::vector<std::pair<uint32_t, std::vector<uint32_t>>> stack;
+        stack.emplace_back(root, callees(m_Module.functions[root]));
+        while (!stack.empty()) {
+            auto& [function, pending] = stack.back();
+            if (pending.empty()) {
+                order.push_back(function);
+                stack.pop_back();
+                continue;
+            }
+            const uint32_t callee = pending.back();
+            pending.pop_back();
+            if (!visited[callee]) {
+                visited[callee] = true;
+                stack.emplace_back(callee, callees(m_Module.functions[callee]));
+            }
+        }
+    }
+    return order;
+}
+
+bool Inliner::inlineCalls(const uint32_t caller) {
+    bool changed = false;
+    // inlining splits the block after the call, scanning goes on in the copied body
+    for (uint32_t b = 0; b < m_Module.functions[caller].blocks.size(); b++) {
+        const std::vector<IRInst>& insts = m_Module.functions[caller].blocks[b].insts;
+        for (size_t i = 0; i < insts.size(); i++) {
+            if (insts[i].op != IROp::Call) {
+                continue;
+            }
+            const auto callee = static_cast<uint32_t>(insts[i].imm);
+            InlineStats::Thingy& stats = m_Stats.thingies[callee];
+            stats.calls++;
+            if (m_Recursive[callee] || stats.cost > maxInlineCost || !returnsAsDeclared(m_Module.functions[callee])
+                || size(m_Module.functions[caller]) + stats.cost > maxCallerSize) {
+                continue;
+            }
+
+            inlineCall(caller, b, i);
+            stats.inlined++;
+            changed = true;
+            break;
+        }
+    }
+    return changed;
+}
+
+void Inliner::inlineCall(const uint32_t caller, const uint32_t block, const size_t index) {
+    IRFunction& function = m_Module.functions[caller];
+    const IRInst call = function.blocks[block].insts[index];
+    const IRFunction& callee = m_Module.functions[call.imm];
+    const uint32_t copy = m_InlineCount++;
+
+    std::vector<VReg> regs(callee.types.size());
+    for (VReg reg = 0; reg < callee.types.size(); reg++) {
+        regs[reg] = function.newVReg(callee.types[reg]);
+    }
+    const auto remap = [&](const VReg reg) { return reg == NoVReg ? NoVReg : regs[reg]; };
+
+    // the callee's blocks follow the caller's, then comes the rest of the block the call was in
+    const auto first = static_cast<uint32_t>(function.blocks.size());
+    const auto after = static_cast<uint32_t>(first + callee.blocks.size());
+    std::vector<IRBlock> body;
+    for (const IRBlock& calleeBlock : callee.blocks) {
+        IRBlock clone{ .name = std::format("{}_inline{}", calleeBlock.name, copy) };
+        for (const IRInst& inst : calleeBlock.insts) {
+            IRInst cloned = inst;
+            cloned.a = remap(inst.a);
+            cloned.b = remap(inst.b);
+            cloned.dst = remap(inst.dst);
+            cloned.dst2 = remap(inst.dst2);
+            if (inst.argCount > 0) {
+                std::vector<VReg> args;
+                for (uint32_t i = 0; i < inst.argCount; i++) {
+                    args.push_back(regs[callee.args[inst.argBegin + i]]);
+                }
+                cloned.argBegin = function.addArgs(args);
+            }
+
+            switch (inst.op) {
+                case IROp::Param:
+                    cloned = IRInst{ .op = IROp::Copy, .dst = regs[inst.dst], .a = function.args[call.argBegin + inst.imm] };
+                    break;
+                case IROp::Jmp:
+                    cloned.target += first;
+                    break;
+                case IROp::Br:
+                    cloned.target += first;
+                    cloned.elseTarget += first;
+                    break;
+                case IROp::Ret:
+                    if (inst.count > 0) {
+                        clone.insts.push_back(IRInst{ .op = IROp::Copy, .dst = call.dst, .a = regs[inst.a] });
+                    }
+                    if (inst.count > 1) {
+                        clone.insts.push_back(IRInst{ .op = IROp::Copy, .dst = call.dst2, .a = regs[inst.b] });
+                    }
+                    cloned = IRInst{ .op = IROp::Jmp, .target = after };
+                    break;
+                default:
+                    break;
+            }
+            clone.insts.push_back(cloned);
+        }
+        body.push_back(std::move(clone));
+    }
+
+    std::vector<IRInst>& insts = function.blocks[block].insts;
+    IRBlock rest{ .name = std::format("{}_return{}", callee.name, copy) };
+    rest.insts.assign(insts.begin() + static_cast<std::ptrdiff_t>(index) + 1, insts.end());
+    insts.resize(index);
+    insts.push_back(IRInst{ .op = IROp::Jmp, .target = first });
+    for (IRBlock& clone : body) {
+        function.blocks.push_back(std::move(clone));
+    }
+    function.blocks.push_back(std::move(rest));
+
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b < first; b++) {
+        order.push_back(b);
+        if (b == block) {
+            for (uint32_t added = first; added <= after; added++) {
+                order.push_back(added);
+            }
+        }
+    }
+    function.reorderBlocks(order);
+}
+
+void Inliner::removeUnreachable() {
+    const size_t count = m_Module.functions.size();
+    std::vector<bool> reached(count, false);
+    std::vector<uint32_t> worklist;
+    for (uint32_t f = 0; f < count; f++) {
+        if (m_Module.functions[f].isEntry) {
+            worklist.push_back(f);
+        }
+    }
+    while (!worklist.empty()) {
+        const uint32_t function = worklist.back();
+        worklist.pop_back();
+        if (reached[function]) {
+            continue;
+        }
+        reached[function] = true;
+        const std::vector<uint32_t> called = callees(m_Module.functions[function]);
+        worklist.insert(worklist.end(), called.begin(), called.end());
+    }
+
+    std::vector<uint32_t> index(count, UINT32_MAX);
+    std::vector<IRFunction> kept;
+    for (uint32_t f = 0; f < count; f++) {
+        if (reached[f]) {
+            index[f] = static_cast<uint32_t>(kept.size());
+            kept.push_back(std::move(m_Module.functions[f]));
+        }
+    }
+    m_Stats.removed = static_cast<uint32_t>(count - kept.size());
+    for (IRFunction& function : kept) {
+        for (IRBlock& block : function.blocks) {
+            for (IRInst& inst : block.insts) {
+                if (inst.op == IROp::Call) {
+                    inst.imm = index[inst.imm];
+                }
+            }
+        }
+    }
+    m_Module.functions = std::move(kept);
+}
+
+uint32_t Inliner::cost(const IRFunction& function) {
+    uint32_t cost = 0;
+    for (const IRBlock& block : function.blocks) {
+        for (const IRInst& inst : block.insts) {
+            // parameters turn into copies of the arguments and returns into the jump back, both mostly vanish
+            if (inst.op != IROp::Param && inst.op != IROp::Jmp && inst.op != IROp::Ret) {
+                cost++;
+            }
+        }
+    }
+    return cost;
+}
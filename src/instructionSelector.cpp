@@ -0,0 +1,387 @@
+#include "InstructionSelector.hpp"
+
+#include <bit>
+
+namespace {
+    // multiply-high constant for unsigned 64-bit division by a divisor that is not a power of two.
+    // with add set the quotient is ((x - hi) >> 1 + hi) >> shift, otherwise hi >> shift,
+    // hi being the upper half of x * multiplier (Granlund and Montgomery)
+    struct MagicDivisor {
+        uint64_t multiplier;
+        uint8_t shift;
+        bool add;
+    };
+
+    MagicDivisor magicDivisor(const uint64_t divisor) {
+        using u128 = unsigned __int128;
+        const int log = 64 - std::countl_zero(divisor - 1); // ceil(log2(divisor))
+
+        // the smallest shift whose rounded up reciprocal still fits 64 bits and is exact for every dividend
+        for (int shift = 0; shift < log; shift++) {
+            const u128 power = static_cast<u128>(1) << (64 + shift);
+            const u128 multiplier = power / divisor + 1;
+            if (multiplier >> 64 == 0 && multiplier * divisor - power <= (static_cast<u128>(1) << shift)) {
+                return { static_cast<uint64_t>(multiplier), static_cast<uint8_t>(shift), false };
+            }
+        }
+
+        const u128 multiplier = ((static_cast<u128>(1) << 64) * ((static_cast<u128>(1) << log) - divisor)) / divisor + 1;
+        return { static_cast<uint64_t>(multiplier), static_cast<uint8_t>(log - 1), true };
+    }
+}
+
+Cond InstructionSelector::condition(const CmpOp cmp) {
+    static constexpr Cond conds[] = { Cond::E, Cond::NE, Cond::L, Cond::LE, Cond::G, Cond::GE };
+    return conds[static_cast<size_t>(cmp)];
+}
+
+InstructionSelector::InstructionSelector(const IRModule& module) : m_IR(module) {
+    m_Strcat = m_Module.addLabel("__whacky_strcat");
+    m_Strmul = m_Module.addLabel("__whacky_strmul");
+    m_Module.externs.push_back(m_Strcat);
+    m_Module.externs.push_back(m_Strmul);
+}
+
+MModule InstructionSelector::select() {
+    for (size_t i = 0; i < m_IR.strings.size(); i++) {
+        const uint32_t label = m_Module.addLabel("str" + std::to_string(i));
+        m_StringLabels.push_back(label);
+        m_Module.data.push_back(MData{ label, m_IR.strings[i] });
+    }
+    for (const IRFunction& function : m_IR.functions) {
+        m_FunctionLabels.push_back(m_Module.addLabel(function.name));
+    }
+
+    for (const IRFunction& function : m_IR.functions) {
+        selectFunction(function);
+    }
+    return std::move(m_Module);
+}
+
+void InstructionSelector::selectFunction(const IRFunction& function) {
+    m_Current = &function;
+    m_Module.functions.push_back(MFunction{
+        .label = m_FunctionLabels[&function - m_IR.functions.data()],
+        .isEntry = function.isEntry,
+        .nextVReg = reg(static_cast<VReg>(function.types.size())),
+    });
+    m_OutLenSlot = UINT32_MAX;
+
+    std::vector<uint32_t> defCount(function.types.size(), 0);
+    m_Constants.assign(function.types.size(), std::nullopt);
+    m_UseCount.assign(function.types.size(), 0);
+    for (const IRBlock& block : function.blocks) {
+        for (const IRInst& inst : block.insts) {
+            function.forEachUse(inst, [&](const VReg use) { m_UseCount[use]++; });
+            if (inst.dst != NoVReg && defCount[inst.dst]++ == 0 && inst.op == IROp::Const) {
+                m_Constants[inst.dst] = inst.imm;
+            }
+            if (inst.dst != NoVReg && defCount[inst.dst] > 1) {
+                m_Constants[inst.dst] = std::nullopt;
+            }
+        }
+    }
+
+    // only blocks something jumps to need a label
+    m_BlockLabels.assign(function.blocks.size(), UINT32_MAX);
+    for (const IRBlock& block : function.blocks) {
+        const IRInst& last = block.insts.back();
+        if (last.op == IROp::Jmp || last.op == IROp::Br) {
+            m_BlockLabels[last.target] = 0;
+        }
+        if (last.op == IROp::Br) {
+            m_BlockLabels[last.elseTarget] = 0;
+        }
+    }
+
+    for (uint32_t b = 0; b < function.blocks.size(); b++) {
+        if (m_BlockLabels[b] != UINT32_MAX) {
+            m_BlockLabels[b] = m_Module.addLabel(function.blocks[b].name);
+        }
+    }
+    for (uint32_t b = 0; b < function.blocks.size(); b++) {
+        if (m_BlockLabels[b] != UINT32_MAX) {
+            fn().emit(MOp::Label, Operand::label(m_BlockLabels[b]));
+        }
+        const std::vector<IRInst>& insts = function.blocks[b].insts;
+        for (size_t i = 0; i < insts.size(); i++) {
+            // a comparison only the branch right after it reads leaves its answer in the flags
+            if (i + 2 == insts.size() && insts[i].op == IROp::Cmp && insts[i + 1].op == IROp::Br
+                && insts[i + 1].a == insts[i].dst && m_UseCount[insts[i].dst] == 1) {
+                fn().emit(MOp::Cmp, Operand::r(reg(insts[i].a)), Operand::r(reg(insts[i].b)));
+                selectBranch(condition(insts[i].cmp), insts[i + 1], b + 1);
+                break;
+            }
+            if (i + 2 == insts.size() && canTailCall(insts[i], insts[i + 1])) {
+                selectTailCall(insts[i]);
+                break;
+            }
+            selectInst(insts[i], b + 1);
+        }
+    }
+}
+
+void InstructionSelector::selectInst(const IRInst& inst, const uint32_t nextBlock) {
+    MFunction& f = fn();
+    switch (inst.op) {
+        case IROp::Const:
+            f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::imm(inst.imm));
+            break;
+        case IROp::StrAddr:
+            f.emit(MOp::Lea, Operand::r(reg(inst.dst)), Operand::label(m_StringLabels[inst.imm]));
+            break;
+        case IROp::Copy:
+            f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(reg(inst.a)));
+            break;
+
+        case IROp::Add:
+            selectBinary(MOp::Add, inst);
+            break;
+        case IROp::Sub:
+            selectBinary(MOp::Sub, inst);
+            break;
+        case IROp::Mul:
+            // only the low 64 bits are kept, which imul computes just like mul
+            if (!selectMulByConstant(inst)) {
+                selectBinary(MOp::Imul, inst);
+            }
+            break;
+        case IROp::And:
+            selectBinary(MOp::And, inst);
+            break;
+        case IROp::Or:
+            selectBinary(MOp::Or, inst);
+            break;
+        case IROp::Xor:
+            selectBinary(MOp::Xor, inst);
+            break;
+        case IROp::Div:
+            if (selectDivByConstant(inst)) {
+                break;
+            }
+            f.emit(MOp::Mov, Operand::r(PhysReg::rax), Operand::r(reg(inst.a)));
+            f.emit(MOp::Mov, Operand::r(PhysReg::rdx), Operand::imm(0));
+            f.emit(MOp::Div, Operand::r(reg(inst.b)));
+            f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(PhysReg::rax));
+            break;
+
+        case IROp::Cmp:
+            f.emit(MOp::Cmp, Operand::r(reg(inst.a)), Operand::r(reg(inst.b)));
+            f.emitCond(MOp::Setcc, condition(inst.cmp), Operand::r(reg(inst.dst)));
+            f.emit(MOp::Movzx8, Operand::r(reg(inst.dst)), Operand::r(reg(inst.dst)));
+            break;
+
+        case IROp::Param:
+            // the first six slots come in registers, the caller pushed the rest right above the return address
+            if (inst.imm < argRegCount) {
+                f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(callArgRegs[inst.imm]));
+            } else {
+                f.emit(MOp::Mov, Operand::r(reg(inst.dst)), stackArg(static_cast<uint32_t>(inst.imm)));
+            }
+            break;
+
+        case IROp::Call:
+            selectCall(inst);
+            break;
+        case IROp::CallRuntime:
+            selectRuntimeCall(inst);
+            break;
+
+        case IROp::Write:
+            f.emit(MOp::Mov, Operand::r(PhysReg::rsi), Operand::r(reg(inst.a))); // ptr
+            f.emit(MOp::Mov, Operand::r(PhysReg::rdx), Operand::r(reg(inst.b))); // len
+            f.emit(MOp::Mov, Operand::r(PhysReg::rdi), Operand::imm(1));
+            f.emit(MOp::Mov, Operand::r(PhysReg::rax), Operand::imm(1));
+            f.emitCounted(MOp::Syscall, 3);
+            break;
+        case IROp::Exit:
+            f.emit(MOp::Mov, Operand::r(PhysReg::rdi), Operand::r(reg(inst.a)));
+            f.emit(MOp::Mov, Operand::r(PhysReg::rax), Operand::imm(60));
+            f.emitCounted(MOp::Syscall, 1);
+            break;
+
+        case IROp::Jmp:
+            if (inst.target != nextBlock) {
+                f.emit(MOp::Jmp, Operand::label(m_BlockLabels[inst.target]));
+            }
+            break;
+        case IROp::Br:
+            f.emit(MOp::Cmp, Operand::r(reg(inst.a)), Operand::imm(0));
+            selectBranch(Cond::NE, inst, nextBlock);
+            break;
+        case IROp::Ret:
+            // strings come back as pointer in rax and length in rdx
+            if (inst.count > 0) {
+                f.emit(MOp::Mov, Operand::r(PhysReg::rax), Operand::r(reg(inst.a)));
+            }
+            if (inst.count > 1) {
+                f.emit(MOp::Mov, Operand::r(PhysReg::rdx), Operand::r(reg(inst.b)));
+            }
+            f.emitCounted(MOp::Ret, inst.count);
+            break;
+    }
+}
+
+void InstructionSelector::selectBranch(const Cond cond, const IRInst& inst, const uint32_t nextBlock) {
+    MFunction& f = fn();
+    if (inst.target == nextBlock) {
+        f.emitCond(MOp::Jcc, invertCond(cond), Operand::label(m_BlockLabels[inst.elseTarget]));
+        return;
+    }
+    f.emitCond(MOp::Jcc, cond, Operand::label(m_BlockLabels[inst.target]));
+    if (inst.elseTarget != nextBlock) {
+        f.emit(MOp::Jmp, Operand::label(m_BlockLabels[inst.elseTarget]));
+    }
+}
+
+void InstructionSelector::selectBinary(const MOp op, const IRInst& inst) {
+    MFunction& f = fn();
+    // two-operand form: the left operand is copied into dst first unless that would clobber the right one
+    MReg dst = reg(inst.dst);
+    const bool clobbers = inst.dst == inst.b && inst.dst != inst.a;
+    if (clobbers) {
+        dst = f.newVReg();
+    }
+    f.emit(MOp::Mov, Operand::r(dst), Operand::r(reg(inst.a)));
+    f.emit(op, Operand::r(dst), Operand::r(reg(inst.b)));
+    if (clobbers) {
+        f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(dst));
+    }
+}
+
+bool InstructionSelector::selectMulByConstant(const IRInst& inst) {
+    const bool leftConstant = constant(inst.a).has_value();
+    if (!leftConstant && !constant(inst.b).has_value()) {
+        return false;
+    }
+    const auto factor = static_cast<uint64_t>(leftConstant ? constant(inst.a).value() : constant(inst.b).value());
+    const Operand other = Operand::r(reg(leftConstant ? inst.b : inst.a));
+    const Operand dst = Operand::r(reg(inst.dst));
+
+    MFunction& f = fn();
+    if (factor == 0) {
+        f.emit(MOp::Mov, dst, Operand::imm(0));
+    } else if (std::has_single_bit(factor)) {
+        f.emit(MOp::Mov, dst, other);
+        if (factor > 1) {
+            f.emit(MOp::Shl, dst, Operand::imm(std::countr_zero(factor)));
+        }
+    } else if (factor == 3 || factor == 5 || factor == 9) {
+        f.insts.push_back(MInst{ .op = MOp::LeaScaled, .count = static_cast<uint8_t>(factor - 1), .dst = dst, .src = other });
+    } else {
+        // imul takes the constant as an immediate once the peephole optimizer folds it
+        return false;
+    }
+    return true;
+}
+
+bool InstructionSelector::selectDivByConstant(const IRInst& inst) {
+    // a zero divisor keeps its div so it still traps
+    if (!constant(inst.b).has_value() || constant(inst.b).value() == 0) {
+        return false;
+    }
+    const auto divisor = static_cast<uint64_t>(constant(inst.b).value());
+    const Operand dividend = Operand::r(reg(inst.a));
+    const Operand dst = Operand::r(reg(inst.dst));
+
+    MFunction& f = fn();
+    if (std::has_single_bit(divisor)) {
+        f.emit(MOp::Mov, dst, dividend);
+        if (divisor > 1) {
+            f.emit(MOp::Shr, dst, Operand::imm(std::countr_zero(divisor)));
+        }
+        return true;
+    }
+
+    const MagicDivisor magic = magicDivisor(divisor);
+    f.emit(MOp::Mov, Operand::r(PhysReg::rax), Operand::imm(static_cast<int64_t>(magic.multiplier)));
+    f.emit(MOp::Mul, dividend);
+    const MReg high = f.newVReg();
+    f.emit(MOp::Mov, Operand::r(high), Operand::r(PhysReg::rdx));
+    if (magic.add) {
+        const MReg sum = f.newVReg();
+        f.emit(MOp::Mov, Operand::r(sum), dividend);
+        f.emit(MOp::Sub, Operand::r(sum), Operand::r(high));
+        f.emit(MOp::Shr, Operand::r(sum), Operand::imm(1));
+        f.emit(MOp::Add, Operand::r(sum), Operand::r(high));
+        f.emit(MOp::Mov, dst, Operand::r(sum));
+    } else {
+        f.emit(MOp::Mov, dst, Operand::r(high));
+    }
+    if (magic.shift > 0) {
+        f.emit(MOp::Shr, dst, Operand::imm(magic.shift));
+    }
+    return true;
+}
+
+void InstructionSelector::selectCall(const IRInst& inst) {
+    MFunction& f = fn();
+    // System V: slots past the sixth are pushed last to first so the seventh ends up lowest,
+    // rsp stays 16 byte aligned at the call
+    const uint32_t stackCount = stackSlots(inst.argCount);
+    const size_t padding = (stackCount % 2) * 8;
+    if (padding > 0) {
+        f.emit(MOp::Sub, Operand::r(PhysReg::rsp), Operand::imm(static_cast<int64_t>(padding)));
+    }
+    for (uint32_t i = inst.argCount; i-- > inst.argCount - stackCount;) {
+        f.emit(MOp::Push, Operand::r(reg(m_Current->args[inst.argBegin + i])));
+    }
+    const uint32_t regCount = inst.argCount - stackCount;
+    for (uint32_t i = 0; i < regCount; i++) {
+        f.emit(MOp::Mov, Operand::r(callArgRegs[i]), Operand::r(reg(m_Current->args[inst.argBegin + i])));
+    }
+
+    f.emitCounted(MOp::Call, static_cast<uint8_t>(regCount), Operand::label(m_FunctionLabels[inst.imm]));
+    const size_t cleanup = stackCount * 8 + padding;
+    if (cleanup > 0) {
+        f.emit(MOp::Add, Operand::r(PhysReg::rsp), Operand::imm(static_cast<int64_t>(cleanup)));
+    }
+
+    f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(PhysReg::rax));
+    if (inst.dst2 != NoVReg) {
+        f.emit(MOp::Mov, Operand::r(reg(inst.dst2)), Operand::r(PhysReg::rdx));
+    }
+}
+
+bool InstructionSelector::canTailCall(const IRInst& call, const IRInst& ret) const {
+    // stack arguments go where ours came in, so they have to fit in there
+    return isTailCall(call, ret) && !m_Current->isEntry
+        && stackSlots(m_IR.functions[call.imm].paramSlots) <= stackSlots(m_Current->paramSlots);
+}
+
+void InstructionSelector::selectTailCall(const IRInst& inst) {
+    MFunction& f = fn();
+    // our own arguments were read into registers on entry, their slots are free to take the callee's
+    const uint32_t regCount = inst.argCount - stackSlots(inst.argCount);
+    for (uint32_t i = regCount; i < inst.argCount; i++) {
+        f.emit(MOp::Mov, stackArg(i), Operand::r(reg(m_Current->args[inst.argBegin + i])));
+    }
+    for (uint32_t i = 0; i < regCount; i++) {
+        f.emit(MOp::Mov, Operand::r(callArgRegs[i]), Operand::r(reg(m_Current->args[inst.argBegin + i])));
+    }
+    f.emitCounted(MOp::TailCall, static_cast<uint8_t>(regCount), Operand::label(m_FunctionLabels[inst.imm]));
+}
+
+void InstructionSelector::selectRuntimeCall(const IRInst& inst) {
+    MFunction& f = fn();
+    // System V: arguments in rdi, rsi, ... followed by a pointer the result length is written through
+    for (uint32_t i = 0; i < inst.argCount; i++) {
+        f.emit(MOp::Mov, Operand::r(callArgRegs[i]), Operand::r(reg(m_Current->args[inst.argBegin + i])));
+    }
+    f.emit(MOp::Lea, Operand::r(callArgRegs[inst.argCount]), Operand::slot(outLenSlot()));
+
+    const bool strcat = static_cast<RuntimeFn>(inst.imm) == RuntimeFn::StrCat;
+    f.emitCounted(MOp::Call, static_cast<uint8_t>(inst.argCount + 1), Operand::label(strcat ? m_Strcat : m_Strmul));
+
+    // rax = result pointer
+    f.emit(MOp::Mov, Operand::r(reg(inst.dst)), Operand::r(PhysReg::rax));
+    f.emit(MOp::Mov, Operand::r(reg(inst.dst2)), Operand::slot(outLenSlot()));
+}
+
+uint32_t InstructionSelector::outLenSlot() {
+    // the runtime writes the result length through a pointer, one slot per function serves every call
+    if (m_OutLenSlot == UINT32_MAX) {
+        m_OutLenSlot = fn().newSlot();
+    }
+    return m_OutLenSlot;
+}
@@ -0,0 +1,9 @@
+#include "Interner.hpp"
+
+NameId Interner::intern(std::string_view name) {
+    const auto [it, inserted] = m_Ids.try_emplace(name, static_cast<NameId>(m_Names.size()));
+    if (inserted) {
+        m_Names.push_back(name);
+    }
+    return it->second;
+}
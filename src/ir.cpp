@@ -0,0 +1,235 @@
+#include "IR.hpp"
+
+#include <format>
+#include <sstream>
+
+bool isTerminator(const IROp op) {
+    switch (op) {
+        case IROp::Exit:
+        case IROp::Jmp:
+        case IROp::Br:
+        case IROp::Ret:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isTailCall(const IRInst& call, const IRInst& ret) {
+    return call.op == IROp::Call && ret.op == IROp::Ret && ret.count > 0
+        && ret.a == call.dst && (ret.count < 2 || ret.b == call.dst2);
+}
+
+uint32_t IRFunction::addArgs(const std::vector<VReg>& values) {
+    const auto begin = static_cast<uint32_t>(args.size());
+    args.insert(args.end(), values.begin(), values.end());
+    return begin;
+}
+
+void IRFunction::reorderBlocks(const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> index(blocks.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < order.size(); i++) {
+        index[order[i]] = i;
+    }
+
+    std::vector<IRBlock> reordered;
+    reordered.reserve(order.size());
+    for (const uint32_t old : order) {
+        reordered.push_back(std::move(blocks[old]));
+        IRInst& last = reordered.back().insts.back();
+        if (last.op == IROp::Jmp || last.op == IROp::Br) {
+            last.target = index[last.target];
+            last.elseTarget = index[last.elseTarget];
+        }
+    }
+    blocks = std::move(reordered);
+}
+
+uint32_t IRModule::addString(const std::string& bytes) {
+    const auto [it, inserted] = stringIndex.try_emplace(bytes, static_cast<uint32_t>(strings.size()));
+    if (inserted) {
+        strings.push_back(bytes);
+    }
+    return it->second;
+}
+
+IRBuilder::IRBuilder(IRModule& module, const size_t function, std::string entryName)
+    : m_Module(module), m_Function(function) {
+    m_Block = createBlock(std::move(entryName));
+    m_Layout.push_back(m_Block);
+}
+
+uint32_t IRBuilder::createBlock(std::string name) {
+    fn().blocks.push_back(IRBlock{ .name = std::move(name) });
+    return static_cast<uint32_t>(fn().blocks.size() - 1);
+}
+
+void IRBuilder::startBlock(const uint32_t block) {
+    if (!fn().blocks[m_Block].terminated()) {
+        jump(block);
+    }
+    m_Block = block;
+    m_Layout.push_back(block);
+}
+
+void IRBuilder::emit(const IRInst& inst) {
+    if (fn().blocks[m_Block].terminated()) {
+        const uint32_t unreachable = createBlock(fn().name + "_unreachable" + std::to_string(fn().blocks.size()));
+        m_Block = unreachable;
+        m_Layout.push_back(unreachable);
+    }
+    fn().blocks[m_Block].insts.push_back(inst);
+}
+
+VReg IRBuilder::value(const IROp op, const IRType type, const VReg a, const VReg b) {
+    const VReg dst = fn().newVReg(type);
+    emit(IRInst{ .op = op, .dst = dst, .a = a, .b = b });
+    return dst;
+}
+
+VReg IRBuilder::constant(const int64_t value, const IRType type) {
+    const VReg dst = fn().newVReg(type);
+    emit(IRInst{ .op = IROp::Const, .dst = dst, .imm = value });
+    return dst;
+}
+
+void IRBuilder::jump(const uint32_t block) {
+    emit(IRInst{ .op = IROp::Jmp, .target = block });
+}
+
+void IRBuilder::branch(const VReg cond, const uint32_t then, const uint32_t otherwise) {
+    emit(IRInst{ .op = IROp::Br, .a = cond, .target = then, .elseTarget = otherwise });
+}
+
+void IRBuilder::finish() {
+    fn().reorderBlocks(m_Layout);
+}
+
+namespace {
+    const char* typeName(const IRType type) {
+        switch (type) {
+            case IRType::Int: return "int";
+            case IRType::Bool: return "bool";
+            case IRType::Ptr: return "ptr";
+        }
+        return "";
+    }
+
+    const char* opName(const IROp op) {
+        switch (op) {
+            case IROp::Add: return "add";
+            case IROp::Sub: return "sub";
+            case IROp::Mul: return "mul";
+            case IROp::Div: return "udiv";
+            case IROp::And: return "and";
+            case IROp::Or: return "or";
+            case IROp::Xor: return "xor";
+            default: return "";
+        }
+    }
+
+    const char* cmpName(const CmpOp cmp) {
+        switch (cmp) {
+            case CmpOp::Eq: return "eq";
+            case CmpOp::Ne: return "ne";
+            case CmpOp::Lt: return "lt";
+            case CmpOp::Le: return "le";
+            case CmpOp::Gt: return "gt";
+            case CmpOp::Ge: return "ge";
+        }
+        return "";
+    }
+
+    std::string escaped(const std::string& bytes) {
+        std::string out;
+        for (const char c : bytes) {
+            if (c >= ' ' && c <= '~' && c != '"' && c != '\\') {
+                out.push_back(c);
+            } else {
+                out += std::format("\\x{:02x}", static_cast<unsigned char>(c));
+            }
+        }
+        return out;
+    }
+}
+
+std::string printIR(const IRModule& module) {
+    std::stringstream out;
+    for (size_t i = 0; i < module.strings.size(); i++) {
+        out << std::format("@str{} = \"{}\"\n", i, escaped(module.strings[i]));
+    }
+
+    for (const IRFunction& fn : module.functions) {
+        out << std::format("\nfunc {}(slots {}) returns {}:\n", fn.name, fn.paramSlots, fn.returnCount);
+        const auto reg = [&](const VReg v) { return std::format("%{}", v); };
+        const auto def = [&](const VReg v) { return std::format("%{}:{}", v, typeName(fn.types[v])); };
+        const auto results = [&](const IRInst& inst) {
+            return inst.dst2 == NoVReg ? def(inst.dst) : def(inst.dst) + ", " + def(inst.dst2);
+        };
+        const auto args = [&](const IRInst& inst) {
+            std::string list;
+            for (uint32_t i = 0; i < inst.argCount; i++) {
+                list += (i > 0 ? ", " : "") + reg(fn.args[inst.argBegin + i]);
+            }
+            return list;
+        };
+
+        for (const IRBlock& block : fn.blocks) {
+            out << block.name << ":\n";
+            for (const IRInst& inst : block.insts) {
+                out << "\t";
+                switch (inst.op) {
+                    case IROp::Const:
+                        out << std::format("{} = {}", def(inst.dst), inst.imm);
+                        break;
+                    case IROp::StrAddr:
+                        out << std::format("{} = @str{}", def(inst.dst), inst.imm);
+                        break;
+                    case IROp::Copy:
+                        out << std::format("{} = {}", def(inst.dst), reg(inst.a));
+                        break;
+                    case IROp::Add: case IROp::Sub: case IROp::Mul: case IROp::Div:
+                    case IROp::And: case IROp::Or: case IROp::Xor:
+                        out << std::format("{} = {} {}, {}", def(inst.dst), opName(inst.op), reg(inst.a), reg(inst.b));
+                        break;
+                    case IROp::Cmp:
+                        out << std::format("{} = cmp {} {}, {}", def(inst.dst), cmpName(inst.cmp), reg(inst.a), reg(inst.b));
+                        break;
+                    case IROp::Param:
+                        out << std::format("{} = param {}", def(inst.dst), inst.imm);
+                        break;
+                    case IROp::Call:
+                        out << std::format("{} = call {}({})", results(inst), module.functions[inst.imm].name, args(inst));
+                        break;
+                    case IROp::CallRuntime:
+                        out << std::format("{} = call {}({})", results(inst),
+                            static_cast<RuntimeFn>(inst.imm) == RuntimeFn::StrCat ? "__whacky_strcat" : "__whacky_strmul", args(inst));
+                        break;
+                    case IROp::Write:
+                        out << std::format("write {}, {}", reg(inst.a), reg(inst.b));
+                        break;
+                    case IROp::Exit:
+                        out << std::format("exit {}", reg(inst.a));
+                        break;
+                    case IROp::Jmp:
+                        out << std::format("jmp {}", fn.blocks[inst.target].name);
+                        break;
+                    case IROp::Br:
+                        out << std::format("br {}, {}, {}", reg(inst.a), fn.blocks[inst.target].name, fn.blocks[inst.elseTarget].name);
+                        break;
+                    case IROp::Ret:
+                        out << "ret";
+                        if (inst.count > 0) {
+                            out << " " << reg(inst.a);
+                        }
+                        if (inst.count > 1) {
+                            out << ", " << reg(inst.b);
+                        }
+                        break;
+                }
+                out << "\n";
+            }
+        }
+    }
+    return out.str();
+}
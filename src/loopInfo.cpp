@@ -0,0 +1,152 @@
+#include "LoopInfo.hpp"
+
+#include <algorithm>
+
+std::vector<uint32_t> successors(const IRBlock& block) {
+    const IRInst& last = block.insts.back();
+    if (last.op == IROp::Br) {
+        return { last.target, last.elseTarget };
+    }
+    if (last.op == IROp::Jmp) {
+        return { last.target };
+    }
+    return {};
+}
+
+LoopInfo::LoopInfo(const IRFunction& function) : m_Function(function) {
+    buildCfg();
+    computeDominators();
+    findLoops();
+}
+
+bool LoopInfo::dominates(const uint32_t a, uint32_t b) const {
+    if (m_Idom[b] == UINT32_MAX) {
+        return false;
+    }
+    while (b != a && b != 0) {
+        b = m_Idom[b];
+    }
+    return b == a;
+}
+
+uint32_t LoopInfo::preheader(const Loop& loop) const {
+    uint32_t preheader = UINT32_MAX;
+    for (const uint32_t pred : m_Preds[loop.header]) {
+        if (loop.blocks[pred]) {
+            continue;
+        }
+        if (preheader != UINT32_MAX) {
+            return UINT32_MAX;
+        }
+        preheader = pred;
+    }
+    if (preheader == UINT32_MAX || m_Function.blocks[preheader].insts.back().op != IROp::Jmp) {
+        return UINT32_MAX;
+    }
+    return preheader;
+}
+
+void LoopInfo::buildCfg() {
+    const std::vector<IRBlock>& blocks = m_Function.blocks;
+    m_Preds.assign(blocks.size(), {});
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        for (const uint32_t succ : successors(blocks[b])) {
+            if (std::ranges::find(m_Preds[succ], b) == m_Preds[succ].end()) {
+                m_Preds[succ].push_back(b);
+            }
+        }
+    }
+}
+
+void LoopInfo::computeDominators() {
+    // Cooper, Harvey and Kennedy: iterate over reverse postorder until the immediate dominators settle
+    const std::vector<IRBlock>& blocks = m_Function.blocks;
+    std::vector<uint32_t> postorder;
+    std::vector<bool> visited(blocks.size(), false);
+    std::vector<std::pair<uint32_t, size_t>> stack = { { 0, 0 } };
+    visited[0] = true;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        const std::vector<uint32_t> succs = successors(blocks[block]);
+        if (next < succs.size()) {
+            const uint32_t succ = succs[next++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.emplace_back(succ, 0);
+            }
+        } else {
+            postorder.push_back(block);
+            stack.pop_back();
+        }
+    }
+
+    m_RpoIndex.assign(blocks.size(), UINT32_MAX);
+    std::vector<uint32_t> rpo(postorder.rbegin(), postorder.rend());
+    for (uint32_t i = 0; i < rpo.size(); i++) {
+        m_RpoIndex[rpo[i]] = i;
+    }
+
+    m_Idom.assign(blocks.size(), UINT32_MAX);
+    m_Idom[0] = 0;
+    const auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (m_RpoIndex[a] > m_RpoIndex[b]) {
+                a = m_Idom[a];
+            }
+            while (m_RpoIndex[b] > m_RpoIndex[a]) {
+                b = m_Idom[b];
+            }
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) {
+            const uint32_t b = rpo[i];
+            uint32_t idom = UINT32_MAX;
+            for (const uint32_t pred : m_Preds[b]) {
+                if (m_Idom[pred] != UINT32_MAX) {
+                    idom = (idom == UINT32_MAX) ? pred : intersect(pred, idom);
+                }
+            }
+            if (m_Idom[b] != idom) {
+                m_Idom[b] = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+void LoopInfo::findLoops() {
+    const std::vector<IRBlock>& blocks = m_Function.blocks;
+    std::vector<uint32_t> loopOf(blocks.size(), UINT32_MAX); // header -> index into m_Loops
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        for (const uint32_t header : successors(blocks[b])) {
+            if (!dominates(header, b)) {
+                continue;
+            }
+
+            // a back edge: the loop is everything that reaches b without passing through the header
+            if (loopOf[header] == UINT32_MAX) {
+                loopOf[header] = static_cast<uint32_t>(m_Loops.size());
+                m_Loops.push_back(Loop{ header, std::vector<bool>(blocks.size(), false), 1 });
+                m_Loops.back().blocks[header] = true;
+            }
+            Loop& loop = m_Loops[loopOf[header]];
+            std::vector<uint32_t> worklist = { b };
+            while (!worklist.empty()) {
+                const uint32_t block = worklist.back();
+                worklist.pop_back();
+                if (loop.blocks[block]) {
+                    continue;
+                }
+                loop.blocks[block] = true;
+                loop.size++;
+                worklist.insert(worklist.end(), m_Preds[block].begin(), m_Preds[block].end());
+            }
+        }
+    }
+    // an inner loop is a strict subset of the loops around it
+    std::ranges::stable_sort(m_Loops, {}, &Loop::size);
+}
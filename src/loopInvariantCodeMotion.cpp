@@ -0,0 +1,246 @@
+#include "LoopInvariantCodeMotion.hpp"
+
+#include <algorithm>
+
+namespace {
+    // registers written once by a constant other than zero, the only divisors that cannot trap
+    std::vector<bool> nonZeroConstants(const IRFunction& function) {
+        std::vector<uint32_t> count(function.types.size(), 0);
+        std::vector<bool> constants(function.types.size(), false);
+        for (const IRBlock& block : function.blocks) {
+            for (const IRInst& inst : block.insts) {
+                for (const VReg reg : { inst.dst, inst.dst2 }) {
+                    if (reg != NoVReg) {
+                        constants[reg] = count[reg]++ == 0 && inst.op == IROp::Const && inst.imm != 0;
+                    }
+                }
+            }
+        }
+        return constants;
+    }
+}
+
+LoopInvariantCodeMotion::LoopInvariantCodeMotion(IRModule& module) : m_Module(module) {
+
+}
+
+void LoopInvariantCodeMotion::run() {
+    analyzeThingies();
+    for (IRFunction& function : m_Module.functions) {
+        m_Function = &function;
+
+        // give every loop a preheader first, each new block renumbers the ones after it
+        bool stable = false;
+        while (!stable) {
+            const LoopInfo info(function);
+            stable = std::ranges::all_of(info.loops(), [&](const Loop& loop) { return ensurePreheader(info, loop); });
+        }
+
+        // inner loops first, what leaves them can then leave the enclosing ones too
+        const LoopInfo info(function);
+        for (const Loop& loop : info.loops()) {
+            hoist(info.preheader(loop), loop);
+        }
+    }
+}
+
+void LoopInvariantCodeMotion::analyzeThingies() {
+    const size_t count = m_Module.functions.size();
+
+    // pure: nothing observable happens, assumed until a write, an exit or an impure callee shows up
+    m_PureThingies.assign(count, true);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < count; f++) {
+            if (!m_PureThingies[f]) {
+                continue;
+            }
+            for (const IRBlock& block : m_Module.functions[f].blocks) {
+                for (const IRInst& inst : block.insts) {
+                    if (inst.op == IROp::Write || inst.op == IROp::Exit
+                        || (inst.op == IROp::Call && !m_PureThingies[inst.imm])) {
+                        m_PureThingies[f] = false;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // safe: pure and always returns, proven bottom up so recursion never qualifies
+    m_SafeThingies.assign(count, false);
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < count; f++) {
+            if (m_SafeThingies[f] || !m_PureThingies[f]) {
+                continue;
+            }
+            const IRFunction& function = m_Module.functions[f];
+            const std::vector<bool> divisors = nonZeroConstants(function);
+            bool safe = true;
+            for (uint32_t b = 0; b < function.blocks.size() && safe; b++) {
+                for (const uint32_t succ : successors(function.blocks[b])) {
+                    safe &= succ > b; // blocks are laid out in source order, a jump back is a loop
+                }
+                for (const IRInst& inst : function.blocks[b].insts) {
+                    safe &= inst.op != IROp::Div || divisors[inst.b];
+                    safe &= inst.op != IROp::CallRuntime;
+                    safe &= inst.op != IROp::Call || m_SafeThingies[inst.imm];
+                }
+            }
+            if (safe) {
+                m_SafeThingies[f] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool LoopInvariantCodeMotion::ensurePreheader(const LoopInfo& info, const Loop& loop) {
+    std::vector<uint32_t> outside;
+    for (const uint32_t pred : info.preds(loop.header)) {
+        if (!loop.blocks[pred]) {
+            outside.push_back(pred);
+        }
+    }
+    // the entry block has no predecessor to route through, its loops are left alone
+    if (outside.empty() || info.preheader(loop) != UINT32_MAX) {
+        return true;
+    }
+
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+    const auto preheader = static_cast<uint32_t>(blocks.size());
+    blocks.push_back(IRBlock{
+        .name = blocks[loop.header].name + "_preheader",
+        .insts = { IRInst{ .op = IROp::Jmp, .target = loop.header } },
+    });
+    for (const uint32_t pred : outside) {
+        IRInst& last = blocks[pred].insts.back();
+        if (last.target == loop.header) {
+            last.target = preheader;
+        }
+        if (last.op == IROp::Br && last.elseTarget == loop.header) {
+            last.elseTarget = preheader;
+        }
+    }
+
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b < preheader; b++) {
+        if (b == loop.header) {
+            order.push_back(preheader);
+        }
+        order.push_back(b);
+    }
+    m_Function->reorderBlocks(order);
+    return false;
+}
+
+void LoopInvariantCodeMotion::hoist(const uint32_t preheader, const Loop& loop) {
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+    if (preheader == UINT32_MAX) {
+        return;
+    }
+
+    countDefs();
+    std::vector<bool> variant(m_Function->types.size(), false); // written somewhere in the loop
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        if (!loop.blocks[b]) {
+            continue;
+        }
+        for (const IRInst& inst : blocks[b].insts) {
+            for (const VReg reg : { inst.dst, inst.dst2 }) {
+                if (reg != NoVReg) {
+                    variant[reg] = true;
+                }
+            }
+        }
+    }
+
+    std::vector<IRInst> hoisted;
+    const auto invariant = [&](const IRInst& inst) {
+        if (inst.dst == NoVReg || m_DefCount[inst.dst] != 1 || (inst.dst2 != NoVReg && m_DefCount[inst.dst2] != 1)) {
+            return false;
+        }
+        bool operandsInvariant = true;
+        m_Function->forEachUse(inst, [&](const VReg reg) { operandsInvariant &= !variant[reg]; });
+        return operandsInvariant;
+    };
+    const auto move = [&](const IRInst& inst) {
+        hoisted.push_back(inst);
+        for (const VReg reg : { inst.dst, inst.dst2 }) {
+            if (reg != NoVReg) {
+                variant[reg] = false;
+            }
+        }
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t b = 0; b < blocks.size(); b++) {
+            if (!loop.blocks[b]) {
+                continue;
+            }
+            // the header runs whenever the preheader did, up to the first instruction with an effect
+            bool effects = false;
+            std::erase_if(blocks[b].insts, [&](const IRInst& inst) {
+                const bool pure = isPure(inst);
+                const bool canMove = (b == loop.header) ? pure && !effects : isSafe(inst);
+                effects |= !pure;
+                if (canMove && invariant(inst)) {
+                    move(inst);
+                    changed = true;
+                    return true;
+                }
+                return false;
+            });
+        }
+    }
+
+    std::vector<IRInst>& target = blocks[preheader].insts;
+    target.insert(target.end() - 1, hoisted.begin(), hoisted.end());
+}
+
+bool LoopInvariantCodeMotion::isPure(const IRInst& inst) const {
+    switch (inst.op) {
+        case IROp::Const: case IROp::StrAddr: case IROp::Copy:
+        case IROp::Add: case IROp::Sub: case IROp::Mul: case IROp::Div:
+        case IROp::And: case IROp::Or: case IROp::Xor: case IROp::Cmp:
+        case IROp::CallRuntime:
+            return true;
+        case IROp::Call:
+            return m_PureThingies[inst.imm];
+        default:
+            return false;
+    }
+}
+
+bool LoopInvariantCodeMotion::isSafe(const IRInst& inst) const {
+    if (inst.op == IROp::Div) {
+        return m_NonZeroConstants[inst.b];
+    }
+    if (inst.op == IROp::Call) {
+        return m_SafeThingies[inst.imm];
+    }
+    // the string helpers allocate and copy as much as their operands ask for, a guard may be what keeps that small
+    if (inst.op == IROp::CallRuntime) {
+        return false;
+    }
+    return isPure(inst);
+}
+
+void LoopInvariantCodeMotion::countDefs() {
+    m_NonZeroConstants = nonZeroConstants(*m_Function);
+    m_DefCount.assign(m_Function->types.size(), 0);
+    for (const IRBlock& block : m_Function->blocks) {
+        for (const IRInst& inst : block.insts) {
+            for (const VReg reg : { inst.dst, inst.dst2 }) {
+                if (reg != NoVReg) {
+                    m_DefCount[reg]++;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,248 @@
+#include "LoopUnroller.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    // a copied header runs on every iteration, keep it to a condition
+    constexpr size_t maxRotatedHeader = 16;
+    // instructions all copies of an unrolled body may add up to
+    constexpr size_t maxUnrolledSize = 64;
+}
+
+LoopUnroller::LoopUnroller(IRModule& module, const uint32_t factor) : m_Module(module), m_Factor(factor) {
+
+}
+
+void LoopUnroller::run() {
+    for (IRFunction& function : m_Module.functions) {
+        m_Function = &function;
+
+        // rotating changes no block indices and leaves the loops around it as they are
+        countDefs();
+        const LoopInfo info(function);
+        for (const Loop& loop : info.loops()) {
+            if (rotate(info, loop)) {
+                countDefs();
+            }
+        }
+        if (m_Factor <= 1) {
+            continue;
+        }
+
+        // unrolling puts new blocks in front of the loop, going back to front keeps the earlier ones in place
+        countDefs();
+        const LoopInfo rotated(function);
+        std::vector<const Loop*> loops;
+        for (const Loop& loop : rotated.loops()) {
+            loops.push_back(&loop);
+        }
+        std::ranges::sort(loops, std::greater{}, &Loop::header);
+        for (const Loop* loop : loops) {
+            unroll(rotated, *loop);
+        }
+    }
+}
+
+bool LoopUnroller::rotate(const LoopInfo& info, const Loop& loop) {
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+    const IRBlock& header = blocks[loop.header];
+    const IRInst& test = header.insts.back();
+    if (loop.header == 0 || test.op != IROp::Br || loop.blocks[test.target] == loop.blocks[test.elseTarget]
+        || header.insts.size() > maxRotatedHeader) {
+        return false;
+    }
+
+    std::vector<uint32_t> latches;
+    for (const uint32_t pred : info.preds(loop.header)) {
+        if (!loop.blocks[pred]) {
+            continue;
+        }
+        if (blocks[pred].insts.back().op != IROp::Jmp) {
+            return false;
+        }
+        latches.push_back(pred);
+    }
+    // a variable assigned in the header would end up with its stores in several places
+    for (const IRInst& inst : header.insts) {
+        for (const VReg reg : { inst.dst, inst.dst2 }) {
+            if (reg != NoVReg && m_DefCount[reg] != 1) {
+                return false;
+            }
+        }
+    }
+    if (escapes(loop.header)) {
+        return false;
+    }
+
+    for (const uint32_t latch : latches) {
+        blocks[latch].insts.pop_back();
+        cloneInto(blocks[latch].insts, blocks[loop.header].insts);
+    }
+    return true;
+}
+
+bool LoopUnroller::unroll(const LoopInfo& info, const Loop& loop) {
+    // the shape a rotated four loop has: body, var = add var, 1; more = cmp gt end, var; br more, loop, exit
+    std::vector<IRBlock>& blocks = m_Function->blocks;
+    const uint32_t loopBlock = loop.header;
+    const std::vector<IRInst>& insts = blocks[loopBlock].insts;
+    if (loop.size != 1 || insts.size() < 3) {
+        return false;
+    }
+    const IRInst& step = insts[insts.size() - 3];
+    const IRInst& test = insts[insts.size() - 2];
+    const IRInst& branch = insts.back();
+    if (branch.op != IROp::Br || branch.target != loopBlock || branch.a != test.dst
+        || test.op != IROp::Cmp || test.cmp != CmpOp::Gt || test.b != step.dst
+        || step.op != IROp::Add || step.a != step.dst || !m_Ones[step.b]) {
+        return false;
+    }
+    const VReg var = step.dst;
+    const VReg end = test.a;
+    const std::span<const IRInst> body(insts.data(), insts.size() - 2); // with the step
+    for (size_t i = 0; i + 1 < body.size(); i++) {
+        for (const VReg reg : { body[i].dst, body[i].dst2 }) {
+            if (reg != NoVReg && (reg == var || reg == end)) {
+                return false;
+            }
+        }
+    }
+    if (end == var || body.size() * m_Factor > maxUnrolledSize || escapes(loopBlock)) {
+        return false;
+    }
+
+    uint32_t entry = UINT32_MAX;
+    for (const uint32_t pred : info.preds(loopBlock)) {
+        if (pred != loopBlock) {
+            if (entry != UINT32_MAX) {
+                return false;
+            }
+            entry = pred;
+        }
+    }
+
+    // more than factor - 1 iterations left. end - var only wraps when more remain than fit in a number,
+    // which leaves everything to the remainder loop
+    const auto remaining = [&](std::vector<IRInst>& out, const VReg enough) {
+        const VReg left = m_Function->newVReg(IRType::Int);
+        const VReg more = m_Function->newVReg(IRType::Bool);
+        out.push_back(IRInst{ .op = IROp::Sub, .dst = left, .a = end, .b = var });
+        out.push_back(IRInst{ .op = IROp::Cmp, .cmp = CmpOp::Gt, .dst = more, .a = left, .b = enough });
+        return more;
+    };
+
+    const auto check = static_cast<uint32_t>(blocks.size());
+    const uint32_t unrolled = check + 1;
+    const uint32_t rest = check + 2;
+    const std::string name = blocks[loopBlock].name;
+    const uint32_t exit = branch.elseTarget;
+
+    IRBlock checkBlock{ .name = name + "_unroll", .insts = {} };
+    const VReg enough = m_Function->newVReg(IRType::Int);
+    checkBlock.insts.push_back(IRInst{ .op = IROp::Const, .dst = enough, .imm = m_Factor - 1 });
+    const VReg go = remaining(checkBlock.insts, enough);
+    checkBlock.insts.push_back(IRInst{ .op = IROp::Br, .a = go, .target = unrolled, .elseTarget = loopBlock });
+
+    IRBlock unrolledBlock{ .name = name + "_unrolled", .insts = {} };
+    for (uint32_t i = 0; i < m_Factor; i++) {
+        cloneInto(unrolledBlock.insts, body);
+    }
+    const VReg again = remaining(unrolledBlock.insts, enough);
+    unrolledBlock.insts.push_back(IRInst{ .op = IROp::Br, .a = again, .target = unrolled, .elseTarget = rest });
+
+    IRBlock restBlock{ .name = name + "_rest", .insts = {} };
+    const VReg more = m_Function->newVReg(IRType::Bool);
+    restBlock.insts.push_back(IRInst{ .op = IROp::Cmp, .cmp = CmpOp::Gt, .dst = more, .a = end, .b = var });
+    restBlock.insts.push_back(IRInst{ .op = IROp::Br, .a = more, .target = loopBlock, .elseTarget = exit });
+
+    IRInst& enter = blocks[entry].insts.back();
+    if (enter.target == loopBlock) {
+        enter.target = check;
+    }
+    if (enter.op == IROp::Br && enter.elseTarget == loopBlock) {
+        enter.elseTarget = check;
+    }
+    blocks.push_back(std::move(checkBlock));
+    blocks.push_back(std::move(unrolledBlock));
+    blocks.push_back(std::move(restBlock));
+
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b < check; b++) {
+        if (b == loopBlock) {
+            order.insert(order.end(), { check, unrolled, rest });
+        }
+        order.push_back(b);
+    }
+    m_Function->reorderBlocks(order);
+    return true;
+}
+
+void LoopUnroller::cloneInto(std::vector<IRInst>& out, const std::span<const IRInst> insts) {
+    std::unordered_map<VReg, VReg> renamed;
+    const auto use = [&](const VReg reg) {
+        const auto it = renamed.find(reg);
+        return it == renamed.end() ? reg : it->second;
+    };
+    const auto def = [&](const VReg reg) {
+        if (reg == NoVReg || m_DefCount[reg] != 1) {
+            return reg;
+        }
+        const VReg fresh = m_Function->newVReg(m_Function->types[reg]);
+        renamed[reg] = fresh;
+        return fresh;
+    };
+
+    // out may be one of the blocks insts points into, copy first
+    std::vector<IRInst> copies(insts.begin(), insts.end());
+    for (IRInst& inst : copies) {
+        inst.a = inst.a == NoVReg ? NoVReg : use(inst.a);
+        inst.b = inst.b == NoVReg ? NoVReg : use(inst.b);
+        if (inst.argCount > 0) {
+            std::vector<VReg> args(m_Function->args.begin() + inst.argBegin, m_Function->args.begin() + inst.argBegin + inst.argCount);
+            for (VReg& arg : args) {
+                arg = use(arg);
+            }
+            inst.argBegin = m_Function->addArgs(args);
+        }
+        inst.dst = def(inst.dst);
+        inst.dst2 = def(inst.dst2);
+    }
+    out.insert(out.end(), copies.begin(), copies.end());
+}
+
+bool LoopUnroller::escapes(const uint32_t block) const {
+    std::vector<bool> local(m_Function->types.size(), false);
+    for (const IRInst& inst : m_Function->blocks[block].insts) {
+        for (const VReg reg : { inst.dst, inst.dst2 }) {
+            if (reg != NoVReg && m_DefCount[reg] == 1) {
+                local[reg] = true;
+            }
+        }
+    }
+
+    bool escaped = false;
+    for (uint32_t b = 0; b < m_Function->blocks.size(); b++) {
+        if (b == block) {
+            continue;
+        }
+        for (const IRInst& inst : m_Function->blocks[b].insts) {
+            m_Function->forEachUse(inst, [&](const VReg reg) { escaped |= local[reg]; });
+        }
+    }
+    return escaped;
+}
+
+void LoopUnroller::countDefs() {
+    m_DefCount.assign(m_Function->types.size(), 0);
+    m_Ones.assign(m_Function->types.size(), false);
+    for (const IRBlock& block : m_Function->blocks) {
+        for (const IRInst& inst : block.insts) {
+            for (const VReg reg : { inst.dst, inst.dst2 }) {
+                if (reg != NoVReg) {
+                    m_Ones[reg] = m_DefCount[reg]++ == 0 && inst.op == IROp::Const && inst.imm == 1;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#include "MachineIR.hpp"
+
+const char* regName(const PhysReg reg) {
+    static constexpr const char* names[] = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+    };
+    return names[static_cast<size_t>(reg)];
+}
+
+const char* regName8(const PhysReg reg) {
+    static constexpr const char* names[] = {
+        "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+        "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+    };
+    return names[static_cast<size_t>(reg)];
+}
+
+const char* condName(const Cond cond) {
+    switch (cond) {
+        case Cond::E: return "e";
+        case Cond::NE: return "ne";
+        case Cond::L: return "l";
+        case Cond::LE: return "le";
+        case Cond::G: return "g";
+        case Cond::GE: return "ge";
+        case Cond::B: return "b";
+        case Cond::BE: return "be";
+        case Cond::A: return "a";
+        case Cond::AE: return "ae";
+    }
+    return "";
+}
+
+Cond invertCond(const Cond cond) {
+    switch (cond) {
+        case Cond::E: return Cond::NE;
+        case Cond::NE: return Cond::E;
+        case Cond::L: return Cond::GE;
+        case Cond::LE: return Cond::G;
+        case Cond::G: return Cond::LE;
+        case Cond::GE: return Cond::L;
+        case Cond::B: return Cond::AE;
+        case Cond::BE: return Cond::A;
+        case Cond::A: return Cond::BE;
+        case Cond::AE: return Cond::B;
+    }
+    return cond;
+}
+
+bool isTerminator(const MInst& inst) {
+    return inst.op == MOp::Jmp || inst.op == MOp::Ret || inst.op == MOp::TailCall;
+}
@@ -1,40 +1,131 @@
+#include <charconv>
+#include <format>
 #include <iostream>
 #include <string>
-#include <sstream>
 #include <fstream>
 
+#include "AsmPrinter.hpp"
+#include "CharScan.hpp"
+#include "ConstantFolder.hpp"
+#include "DeadCodeEliminator.hpp"
 #include "Generator.hpp"
+#include "Inliner.hpp"
+#include "InstructionSelector.hpp"
+#include "LoopInvariantCodeMotion.hpp"
+#include "LoopUnroller.hpp"
+#include "ObjectWriter.hpp"
 #include "Parser.hpp"
+#include "PeepholeOptimizer.hpp"
+#include "RegisterAllocator.hpp"
+#include "SourceBuffer.hpp"
+#include "TailCallEliminator.hpp"
 #include "Tokenizer.hpp"
 
-int main(int argc, char* argv[]) {
-    if(argc != 2) {
-        std::cerr << "Incorrect usage. Correct usage is ..." << std::endl;
-        std::cerr << "whacky <input.wy>" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+struct Options {
+    std::string input;
+    bool emitIR = false;
+    bool emitAsm = false; // go through nasm instead of writing the object file directly
+    bool stats = false;
+    uint32_t unroll = 4; // 1 keeps loops rolled
+    bool noInline = false;
+};
 
-    std::string contents;
-    {
-        std::stringstream contentsStream;
-        std::fstream input(argv[1], std::ios::in);
-        contentsStream << input.rdbuf();
-        contents = contentsStream.str();
+static void usage() {
+    std::cerr << "Incorrect usage. Correct usage is ..." << std::endl;
+    std::cerr << "whacky [--emit-ir] [--emit-asm] [--stats] [--unroll=N] [--no-inline] <input.wy | ->" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+static Options parseOptions(const int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--emit-ir") {
+            options.emitIR = true;
+        } else if (arg == "--emit-asm") {
+            options.emitAsm = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--no-inline") {
+            options.noInline = true;
+        } else if (arg.starts_with("--unroll=")) {
+            const std::string_view factor = std::string_view(arg).substr(std::string_view("--unroll=").size());
+            const auto [end, ec] = std::from_chars(factor.data(), factor.data() + factor.size(), options.unroll);
+            if (ec != std::errc() || end != factor.data() + factor.size() || options.unroll == 0) {
+                usage();
+            }
+        } else if (arg.starts_with("--") || !options.input.empty()) {
+            usage();
+        } else {
+            options.input = arg;
+        }
+    }
+    if (options.input.empty()) {
+        usage();
     }
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    const Options options = parseOptions(argc, argv);
+
+    const SourceBuffer source(options.input);
+
+    Interner interner;
+    Tokenizer tokenizer(source.view(), interner);
 
-    Tokenizer tokenizer(std::move(contents));
-    std::vector<Token> tokens = tokenizer.tokenize();
+    Parser parser(tokenizer);
+    const Ast ast = parser.parseProg();
 
-    Parser parser(std::move(tokens));
-    NodeProg prog = parser.parseProg();
+    TypeChecker typeChecker(ast, interner);
+    const Annotations annotations = typeChecker.check();
     
     {
-        Generator generator(std::move(prog));
-        std::fstream out("out.asm", std::ios::out);
-        out << generator.generateProg();
+        Generator generator(ast, interner, annotations);
+        IRModule ir = generator.generateProg();
+        TailCallEliminator(ir).run();
+        InlineStats inlineStats;
+        if (!options.noInline) {
+            Inliner(ir, inlineStats).run();
+        }
+        ConstantFolder(ir).run();
+        DeadCodeEliminator(ir).run();
+        LoopInvariantCodeMotion(ir).run();
+        LoopUnroller(ir, options.unroll).run();
+        if (options.emitIR) {
+            std::fstream irOut("out.ir", std::ios::out);
+            irOut << printIR(ir);
+        }
+
+        MModule module = InstructionSelector(ir).select();
+        PeepholeStats peepholeStats;
+        for (MFunction& function : module.functions) {
+            PeepholeOptimizer(function, peepholeStats).run();
+            RegisterAllocator(function).run();
+            PeepholeOptimizer(function, peepholeStats).run();
+        }
+        if (options.stats) {
+            std::cerr << "frontend:\n";
+            std::cerr << std::format("  {:<24} {}\n", "input", source.isMapped() ? "mmap" : "read");
+            std::cerr << std::format("  {:<24} {}\n", "scanner", scan::levelName(scan::level()));
+            if (!options.noInline) {
+                std::cerr << inlineStats.report();
+            }
+            std::cerr << peepholeStats.report();
+        }
+
+        if (options.emitAsm) {
+            std::fstream out("out.asm", std::ios::out);
+            out << AsmPrinter(module).print();
+        } else {
+            std::fstream out("out.o", std::ios::out | std::ios::binary);
+            out << ObjectWriter(module).write();
+        }
     }
 
-    system("nasm -felf64 out.asm");
+    if (options.emitAsm) {
+        system("nasm -felf64 out.asm");
+    }
     system("ld -o out out.o libwhacky_runtime.a -lc -dynamic-linker /lib64/ld-linux-x86-64.so.2");
 
-}
\ No newline at end of file
+}
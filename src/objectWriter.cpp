@@ -0,0 +1,501 @@
+#include "ObjectWriter.hpp"
+
+#include <bit>
+#include <cstring>
+#include <elf.h>
+#include <iostream>
+
+namespace {
+    bool fitsImm8(const int64_t value) { return value >= INT8_MIN && value <= INT8_MAX; }
+
+    // the low nibble of the jcc / setcc opcodes
+    uint8_t condCode(const Cond cond) {
+        switch (cond) {
+            case Cond::E: return 0x4;
+            case Cond::NE: return 0x5;
+            case Cond::L: return 0xC;
+            case Cond::LE: return 0xE;
+            case Cond::G: return 0xF;
+            case Cond::GE: return 0xD;
+            case Cond::B: return 0x2;
+            case Cond::BE: return 0x6;
+            case Cond::A: return 0x7;
+            case Cond::AE: return 0x3;
+        }
+        return 0;
+    }
+
+    template<typename T>
+    std::string raw(const std::vector<T>& values) {
+        return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+}
+
+ObjectWriter::ObjectWriter(const MModule& module) : m_Module(module) {
+    m_Places.assign(module.labels.size(), Place::Text);
+    m_Offsets.assign(module.labels.size(), 0);
+    for (const uint32_t label : module.externs) {
+        m_Places[label] = Place::Extern;
+    }
+}
+
+std::string ObjectWriter::write() {
+    layoutData();
+    encodeText();
+    return buildObject();
+}
+
+void ObjectWriter::layoutData() {
+    for (const MData& data : m_Module.data) {
+        m_Places[data.label] = Place::Data;
+        m_Offsets[data.label] = static_cast<uint32_t>(m_Data.size());
+        m_Data += data.bytes;
+        m_Data.push_back('\0');
+    }
+}
+
+void ObjectWriter::encodeText() {
+    // a jump that has to grow pushes the code behind it further away, so the text is encoded
+    // again until every short jump still reaches its label
+    while (true) {
+        m_Text.clear();
+        m_Fixups.clear();
+        m_Relocations.clear();
+        m_Branch = 0;
+        for (const MFunction& function : m_Module.functions) {
+            m_Offsets[function.label] = static_cast<uint32_t>(m_Text.size());
+            for (const MInst& inst : function.insts) {
+                encodeInst(inst);
+            }
+        }
+
+        bool grown = false;
+        for (const Fixup& fixup : m_Fixups) {
+            const int64_t disp = static_cast<int64_t>(m_Offsets[fixup.label]) - (fixup.offset + 1);
+            if (!fixup.wide && !fitsImm8(disp)) {
+                m_LongBranch[fixup.branch] = true;
+                grown = true;
+            }
+        }
+        if (!grown) {
+            break;
+        }
+    }
+
+    for (const Fixup& fixup : m_Fixups) {
+        const uint32_t size = fixup.wide ? 4 : 1;
+        const int64_t disp = static_cast<int64_t>(m_Offsets[fixup.label]) - (fixup.offset + size);
+        for (uint32_t i = 0; i < size; i++) {
+            m_Text[fixup.offset + i] = static_cast<char>(disp >> (8 * i));
+        }
+    }
+}
+
+void ObjectWriter::encodeInst(const MInst& inst) {
+    const Operand& dst = inst.dst;
+    const Operand& src = inst.src;
+    switch (inst.op) {
+        case MOp::Label:
+            m_Offsets[dst.value] = static_cast<uint32_t>(m_Text.size());
+            return;
+
+        case MOp::Mov:
+            if (src.isReg()) {
+                encodeRM({ 0x89 }, src.reg, dst);
+            } else if (src.isMemory()) {
+                encodeRM({ 0x8B }, dst.reg, src);
+            } else if (!src.isImm()) {
+                error("mov takes a register, memory or an immediate");
+            } else if (dst.isReg() && src.value >= 0 && src.value <= UINT32_MAX) {
+                // writing the low half zeroes the upper one
+                rex(false, 0, dst);
+                byte(0xB8 | (dst.reg & 7));
+                imm32(src.value);
+            } else if (fitsImm32(src.value) || !dst.isReg()) {
+                // sign extended imm32, also the only immediate form with a memory destination
+                if (!fitsImm32(src.value)) {
+                    error("immediate does not fit 32 bits: " + std::to_string(src.value));
+                }
+                encodeRM({ 0xC7 }, 0, dst);
+                imm32(src.value);
+            } else {
+                rex(true, 0, dst);
+                byte(0xB8 | (dst.reg & 7));
+                imm64(src.value);
+            }
+            return;
+        case MOp::Lea:
+            encodeRM({ 0x8D }, dst.reg, src);
+            return;
+        case MOp::LeaScaled: {
+            // lea dst, [src + src * count], a base of rbp / r13 has no mod 00 form and takes a zero disp8
+            const uint8_t reg = static_cast<uint8_t>(dst.reg);
+            const uint8_t base = static_cast<uint8_t>(src.reg);
+            const auto scale = static_cast<uint8_t>(std::countr_zero(inst.count));
+            byte(0x48 | ((reg & 8) >> 1) | ((base & 8) >> 2) | ((base & 8) >> 3));
+            byte(0x8D);
+            const bool disp8 = (base & 7) == 5;
+            byte((disp8 ? 0x44 : 0x04) | ((reg & 7) << 3));
+            byte((scale << 6) | ((base & 7) << 3) | (base & 7));
+            if (disp8) {
+                byte(0);
+            }
+            return;
+        }
+
+        case MOp::Add:
+            encodeAlu(0, inst);
+            return;
+        case MOp::Or:
+            encodeAlu(1, inst);
+            return;
+        case MOp::And:
+            encodeAlu(4, inst);
+            return;
+        case MOp::Sub:
+            encodeAlu(5, inst);
+            return;
+        case MOp::Xor:
+            encodeAlu(6, inst);
+            return;
+        case MOp::Cmp:
+            encodeAlu(7, inst);
+            return;
+        case MOp::Imul:
+            if (!src.isImm()) {
+                encodeRM({ 0x0F, 0xAF }, dst.reg, src);
+            } else if (fitsImm8(src.value)) {
+                encodeRM({ 0x6B }, dst.reg, dst);
+                byte(static_cast<uint8_t>(src.value));
+            } else {
+                encodeRM({ 0x69 }, dst.reg, dst);
+                imm32(src.value);
+            }
+            return;
+        case MOp::Shl:
+            encodeRM({ 0xC1 }, 4, dst);
+            byte(static_cast<uint8_t>(src.value));
+            return;
+        case MOp::Shr:
+            encodeRM({ 0xC1 }, 5, dst);
+            byte(static_cast<uint8_t>(src.value));
+            return;
+        case MOp::Mul:
+            encodeRM({ 0xF7 }, 4, dst);
+            return;
+        case MOp::Div:
+            encodeRM({ 0xF7 }, 6, dst);
+            return;
+
+        case MOp::Setcc:
+            rex(false, 0, dst, true);
+            bytes({ 0x0F, static_cast<uint8_t>(0x90 | condCode(inst.cond)) });
+            modrm(0, dst);
+            return;
+        case MOp::Movzx8:
+            encodeRM({ 0x0F, 0xB6 }, dst.reg, src);
+            return;
+
+        case MOp::Push:
+            if (dst.isReg()) {
+                rex(false, 0, dst);
+                byte(0x50 | (dst.reg & 7));
+            } else if (dst.isImm() && fitsImm8(dst.value)) {
+                byte(0x6A);
+                byte(static_cast<uint8_t>(dst.value));
+            } else if (dst.isImm()) {
+                byte(0x68);
+                imm32(dst.value);
+            } else {
+                encodeRM({ 0xFF }, 6, dst, false);
+            }
+            return;
+        case MOp::Pop:
+            if (dst.isReg()) {
+                rex(false, 0, dst);
+                byte(0x58 | (dst.reg & 7));
+            } else {
+                encodeRM({ 0x8F }, 0, dst, false);
+            }
+            return;
+
+        case MOp::Jmp:
+        case MOp::TailCall:
+            encodeBranch(0xEB, { 0xE9 }, static_cast<uint32_t>(dst.value));
+            return;
+        case MOp::Jcc:
+            encodeBranch(0x70 | condCode(inst.cond), { 0x0F, static_cast<uint8_t>(0x80 | condCode(inst.cond)) },
+                static_cast<uint32_t>(dst.value));
+            return;
+        case MOp::Call:
+            encodeCall(static_cast<uint32_t>(dst.value));
+            return;
+        case MOp::Syscall:
+            bytes({ 0x0F, 0x05 });
+            return;
+        case MOp::Ret:
+            byte(0xC3);
+            return;
+    }
+}
+
+void ObjectWriter::encodeAlu(const uint8_t digit, const MInst& inst) {
+    // add, or, and, sub, xor and cmp share one layout: the opcode row is digit * 8,
+    // +1 writes the register into r/m, +3 the other way round, 0x81 / 0x83 take an immediate
+    const Operand& dst = inst.dst;
+    const Operand& src = inst.src;
+    if (src.isImm()) {
+        if (!fitsImm32(src.value)) {
+            error("immediate does not fit 32 bits: " + std::to_string(src.value));
+        }
+        const bool small = fitsImm8(src.value);
+        encodeRM({ static_cast<uint8_t>(small ? 0x83 : 0x81) }, digit, dst);
+        if (small) {
+            byte(static_cast<uint8_t>(src.value));
+        } else {
+            imm32(src.value);
+        }
+    } else if (src.isReg()) {
+        encodeRM({ static_cast<uint8_t>(digit * 8 + 1) }, src.reg, dst);
+    } else {
+        encodeRM({ static_cast<uint8_t>(digit * 8 + 3) }, dst.reg, src);
+    }
+}
+
+void ObjectWriter::encodeBranch(const uint8_t shortOpcode, const std::initializer_list<uint8_t> longOpcode, const uint32_t label) {
+    if (m_Branch == m_LongBranch.size()) {
+        m_LongBranch.push_back(false);
+    }
+    const bool wide = m_LongBranch[m_Branch];
+    if (wide) {
+        bytes(longOpcode);
+    } else {
+        byte(shortOpcode);
+    }
+    m_Fixups.push_back(Fixup{ static_cast<uint32_t>(m_Text.size()), label, m_Branch++, wide });
+    if (wide) {
+        imm32(0);
+    } else {
+        byte(0);
+    }
+}
+
+void ObjectWriter::encodeCall(const uint32_t label) {
+    byte(0xE8);
+    if (m_Places[label] == Place::Extern) {
+        m_Relocations.push_back(Relocation{ static_cast<uint32_t>(m_Text.size()), label, R_X86_64_PLT32 });
+    } else {
+        m_Fixups.push_back(Fixup{ static_cast<uint32_t>(m_Text.size()), label, s_None, true });
+    }
+    imm32(0);
+}
+
+void ObjectWriter::rex(const bool wide, const uint8_t reg, const Operand& rm, const bool byteReg) {
+    const bool hasBase = rm.isReg() || rm.kind == Operand::Kind::Mem;
+    uint8_t prefix = 0x40;
+    if (wide) {
+        prefix |= 0x08;
+    }
+    if (reg & 8) {
+        prefix |= 0x04;
+    }
+    if (hasBase && (rm.reg & 8)) {
+        prefix |= 0x01;
+    }
+    const bool lowByte = byteReg && rm.isReg() && rm.reg >= toReg(PhysReg::rsp) && rm.reg <= toReg(PhysReg::rdi);
+    if (prefix != 0x40 || lowByte) {
+        byte(prefix);
+    }
+}
+
+void ObjectWriter::modrm(const uint8_t reg, const Operand& rm) {
+    const auto field = static_cast<uint8_t>((reg & 7) << 3);
+    switch (rm.kind) {
+        case Operand::Kind::Reg:
+            byte(0xC0 | field | (rm.reg & 7));
+            return;
+        case Operand::Kind::Mem: {
+            // rsp / r12 as a base need a sib byte, rbp / r13 have no form without a displacement
+            const uint8_t base = rm.reg & 7;
+            const bool noDisp = rm.value == 0 && base != 5;
+            const bool disp8 = !noDisp && fitsImm8(rm.value);
+            byte((noDisp ? 0x00 : disp8 ? 0x40 : 0x80) | field | base);
+            if (base == 4) {
+                byte(0x24);
+            }
+            if (disp8) {
+                byte(static_cast<uint8_t>(rm.value));
+            } else if (!noDisp) {
+                imm32(rm.value);
+            }
+            return;
+        }
+        case Operand::Kind::Label:
+            // rip relative, the displacement is the last field of every instruction that takes a label
+            byte(0x05 | field);
+            m_Relocations.push_back(Relocation{ static_cast<uint32_t>(m_Text.size()), static_cast<uint32_t>(rm.value), R_X86_64_PC32 });
+            imm32(0);
+            return;
+        default:
+            error("operand cannot be encoded as r/m");
+    }
+}
+
+void ObjectWriter::encodeRM(const std::initializer_list<uint8_t> opcode, const uint8_t reg, const Operand& rm, const bool wide) {
+    rex(wide, reg, rm);
+    bytes(opcode);
+    modrm(reg, rm);
+}
+
+void ObjectWriter::bytes(const std::initializer_list<uint8_t> values) {
+    for (const uint8_t value : values) {
+        byte(value);
+    }
+}
+
+void ObjectWriter::imm32(const int64_t value) {
+    for (int i = 0; i < 4; i++) {
+        byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void ObjectWriter::imm64(const int64_t value) {
+    for (int i = 0; i < 8; i++) {
+        byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::string ObjectWriter::buildObject() const {
+    enum : uint16_t { Null, Text, Data, RelaText, SymTab, StrTab, ShStrTab, NoteStack, SectionCount };
+
+    std::string strtab(1, '\0');
+    const auto addName = [](std::string& table, const std::string& name) {
+        const auto offset = static_cast<uint32_t>(table.size());
+        table += name;
+        table.push_back('\0');
+        return offset;
+    };
+
+    const auto symbol = [](const uint32_t name, const unsigned char info, const uint16_t section, const uint64_t value) {
+        Elf64_Sym sym{};
+        sym.st_name = name;
+        sym.st_info = info;
+        sym.st_shndx = section;
+        sym.st_value = value;
+        return sym;
+    };
+
+    // section symbols, every label of the module as a local, then _start and the runtime functions
+    std::vector<Elf64_Sym> symbols(1);
+    symbols.push_back(symbol(0, ELF64_ST_INFO(STB_LOCAL, STT_SECTION), Text, 0));
+    symbols.push_back(symbol(0, ELF64_ST_INFO(STB_LOCAL, STT_SECTION), Data, 0));
+    std::vector<bool> global(m_Module.labels.size(), false);
+    for (const MFunction& function : m_Module.functions) {
+        global[function.label] = function.isEntry;
+    }
+    for (const uint32_t label : m_Module.externs) {
+        global[label] = true;
+    }
+
+    // every local has to come before the first global
+    std::vector<uint32_t> symbolIndex(m_Module.labels.size(), 0);
+    for (uint32_t label = 0; label < m_Module.labels.size(); label++) {
+        if (global[label]) {
+            continue;
+        }
+        symbolIndex[label] = static_cast<uint32_t>(symbols.size());
+        symbols.push_back(symbol(addName(strtab, m_Module.labels[label]), ELF64_ST_INFO(STB_LOCAL, STT_NOTYPE),
+            static_cast<uint16_t>(m_Places[label] == Place::Data ? Data : Text), m_Offsets[label]));
+    }
+    const auto firstGlobal = static_cast<uint32_t>(symbols.size());
+    for (uint32_t label = 0; label < m_Module.labels.size(); label++) {
+        if (!global[label]) {
+            continue;
+        }
+        const bool external = m_Places[label] == Place::Extern;
+        symbolIndex[label] = static_cast<uint32_t>(symbols.size());
+        symbols.push_back(symbol(addName(strtab, m_Module.labels[label]), ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE),
+            static_cast<uint16_t>(external ? SHN_UNDEF : Text), external ? 0 : m_Offsets[label]));
+    }
+
+    // the displacement sits right before the end of the instruction, hence the - 4
+    std::vector<Elf64_Rela> relocations;
+    for (const Relocation& relocation : m_Relocations) {
+        uint32_t symbol = symbolIndex[relocation.label];
+        int64_t addend = -4;
+        if (m_Places[relocation.label] != Place::Extern) {
+            // against the section symbols, which sit at the same index as their section
+            symbol = m_Places[relocation.label] == Place::Data ? Data : Text;
+            addend += m_Offsets[relocation.label];
+        }
+        relocations.push_back(Elf64_Rela{
+            .r_offset = relocation.offset,
+            .r_info = ELF64_R_INFO(symbol, relocation.type),
+            .r_addend = addend,
+        });
+    }
+
+    static constexpr const char* sectionNames[] = {
+        "", ".text", ".data", ".rela.text", ".symtab", ".strtab", ".shstrtab", ".note.GNU-stack",
+    };
+    std::string shstrtab(1, '\0');
+    std::vector<uint32_t> names(SectionCount, 0);
+    for (uint16_t i = Text; i < SectionCount; i++) {
+        names[i] = addName(shstrtab, sectionNames[i]);
+    }
+
+    std::vector<Elf64_Shdr> sections(SectionCount);
+    std::string out(sizeof(Elf64_Ehdr), '\0');
+    const auto addSection = [&](const uint16_t index, const uint32_t type, const uint64_t flags, const std::string& bytes,
+        const uint64_t align) {
+        out.resize((out.size() + align - 1) / align * align, '\0');
+        Elf64_Shdr& section = sections[index];
+        section.sh_name = names[index];
+        section.sh_type = type;
+        section.sh_flags = flags;
+        section.sh_offset = out.size();
+        section.sh_size = bytes.size();
+        section.sh_addralign = align;
+        out += bytes;
+        return &section;
+    };
+
+    addSection(Text, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, m_Text, 16);
+    addSection(Data, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, m_Data, 4);
+    Elf64_Shdr* rela = addSection(RelaText, SHT_RELA, SHF_INFO_LINK, raw(relocations), 8);
+    rela->sh_link = SymTab;
+    rela->sh_info = Text;
+    rela->sh_entsize = sizeof(Elf64_Rela);
+    Elf64_Shdr* symtab = addSection(SymTab, SHT_SYMTAB, 0, raw(symbols), 8);
+    symtab->sh_link = StrTab;
+    symtab->sh_info = firstGlobal;
+    symtab->sh_entsize = sizeof(Elf64_Sym);
+    addSection(StrTab, SHT_STRTAB, 0, strtab, 1);
+    addSection(ShStrTab, SHT_STRTAB, 0, shstrtab, 1);
+    // the stack is not executable
+    addSection(NoteStack, SHT_PROGBITS, 0, "", 1);
+
+    out.resize((out.size() + 7) / 8 * 8, '\0');
+    Elf64_Ehdr header{};
+    header.e_type = ET_REL;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = out.size();
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = SectionCount;
+    header.e_shstrndx = ShStrTab;
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    std::memcpy(out.data(), &header, sizeof(header));
+    out += raw(sections);
+    return out;
+}
+
+void ObjectWriter::error(const std::string& msg) {
+    std::cerr << "[Encoder Error] " << msg << std::endl;
+    exit(EXIT_FAILURE);
+}
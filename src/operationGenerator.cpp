@@ -1,125 +1,91 @@
 #include "OperationGenerator.hpp"
-#include <iostream>
 
-void OperationGenerator::generateArithmetic(BinOp op, VarType leftType, VarType rightType) {
+void OperationGenerator::setBuilder(IRBuilder& builder) {
+    m_Builder = &builder;
+}
+
+Value OperationGenerator::generateArithmetic(BinOp op, VarType leftType, VarType rightType, Value left, Value right) {
     switch (op) {
         case BinOp::Add:
             if (leftType == VarType::String && rightType == VarType::String) {
-                // String concatenation - call runtime function               
-                m_Output << "\t; String concatenation\n";
-                m_Output << "\tmov rdi, rdx\n";         // left pointer (arg1)
-                m_Output << "\tmov rsi, rax\n";         // left length (arg2)
-                m_Output << "\tmov rdx, rcx\n";         // right pointer (arg3)
-                m_Output << "\tmov rcx, rbx\n";         // right length (arg4)
-                m_Output << "\tsub rsp, 8\n";           // allocate space for out_len
-                m_Output << "\tmov r8, rsp\n";          // pointer to out_len (arg5)
-
-                m_Output << "\tcall __whacky_strcat\n";
-                
-                // rax = result pointer
-                m_Output << "\tmov rdx, rax\n";         // result pointer
-                m_Output << "\tpop rax\n";              // result length
-            } else {
-                m_Output << "\tadd rax, rbx\n";
+                // String concatenation - call runtime function
+                return callRuntime(RuntimeFn::StrCat, { left.reg, left.len, right.reg, right.len });
             }
-            break;
-            
+            if (leftType == VarType::String) {
+                // a string plus a number moves its length
+                return { left.reg, m_Builder->value(IROp::Add, IRType::Int, left.len, right.reg) };
+            }
+            if (rightType == VarType::String) {
+                return { right.reg, m_Builder->value(IROp::Add, IRType::Int, left.reg, right.len) };
+            }
+            return { m_Builder->value(IROp::Add, IRType::Int, left.reg, right.reg) };
+
         case BinOp::Sub:
-            m_Output << "\tsub rax, rbx\n";
-            break;
-            
+            return { m_Builder->value(IROp::Sub, IRType::Int, left.reg, right.reg) };
+
         case BinOp::Mul:
-              if ((leftType == VarType::String && rightType == VarType::Number) ||
+            if ((leftType == VarType::String && rightType == VarType::Number) ||
                 (leftType == VarType::Number && rightType == VarType::String)) {
                 // string multiplication
-                m_Output << "\t; String multiplication\n";
-
-                // format: string in rdi/rsi, number in rdx
-                if (leftType == VarType::String) {
-                    m_Output << "\tmov rdi, rdx\n";         // string pointer (arg1)
-                    m_Output << "\tmov rsi, rax\n";         // string length (arg2)
-                    m_Output << "\tmov rdx, rbx\n";         // n (arg3)
-                } else {
-                    m_Output << "\tmov rdi, rcx\n";         // string pointer (arg1)
-                    m_Output << "\tmov rsi, rbx\n";         // string length (arg2)
-                    m_Output << "\tmov rdx, rax\n";         // n (arg3)
-                }
-                
-                m_Output << "\tsub rsp, 8\n";               // allocate space for out_len
-                m_Output << "\tmov rcx, rsp\n";             // pointer to out_len (arg4)
-                m_Output << "\tcall __whacky_strmul\n";
-                
-                // rax = result pointer
-                m_Output << "\tmov rdx, rax\n";             // result pointer
-                m_Output << "\tpop rax\n";                  // result length
-            } else {
-                m_Output << "\tmul rbx\n";
+                const Value str = (leftType == VarType::String) ? left : right;
+                const Value n = (leftType == VarType::String) ? right : left;
+                return callRuntime(RuntimeFn::StrMul, { str.reg, str.len, n.reg });
             }
-            break;
-            break;
-            
+            return { m_Builder->value(IROp::Mul, IRType::Int, left.reg, right.reg) };
+
         case BinOp::Div:
-            m_Output << "\tdiv rbx\n";
-            break;
-    }
-}
+            return { m_Builder->value(IROp::Div, IRType::Int, left.reg, right.reg) };
 
-void OperationGenerator::generateComparison(BinOp op, VarType leftType, VarType rightType) {
-    m_Output << "\tcmp rax, rbx\n";
-    
-    switch (op) {
-        case BinOp::Eq:
-            m_Output << "\tsete al\n";
-            break;
-        case BinOp::Neq:
-            m_Output << "\tsetne al\n";
-            break;
-        case BinOp::Lt:
-            m_Output << "\tsetl al\n";
-            break;
-        case BinOp::Le:
-            m_Output << "\tsetle al\n";
-            break;
-        case BinOp::Gt:
-            m_Output << "\tsetg al\n";
-            break;
-        case BinOp::Ge:
-            m_Output << "\tsetge al\n";
-            break;
+        default:
+            return {};
     }
-    
-    m_Output << "\tmovzx rax, al\n";
 }
 
-void OperationGenerator::generateLogical(BinOp op, VarType leftType, VarType rightType) {
-    m_Output << "\tcmp rax, 0\n";
-    m_Output << "\tsetne al\n";
-    m_Output << "\tmovzx rax, al\n";
-    
-    m_Output << "\tcmp rbx, 0\n";
-    m_Output << "\tsetne bl\n";
-    m_Output << "\tmovzx rbx, bl\n";
-    
-    switch (op) {
-        case BinOp::And:
-            m_Output << "\tand rax, rbx\n";
-            break;
-        case BinOp::Or:
-            m_Output << "\tor rax, rbx\n";
-            break;
-    }
+Value OperationGenerator::generateComparison(BinOp op, VarType leftType, VarType rightType, Value left, Value right) {
+    const VReg result = m_Builder->fn().newVReg(IRType::Bool);
+    m_Builder->emit(IRInst{ .op = IROp::Cmp, .cmp = comparison(op), .dst = result, .a = scalar(left, leftType), .b = scalar(right, rightType) });
+    return { result };
 }
 
-void OperationGenerator::generateBitwise(BinOp op, VarType leftType, VarType rightType) {
+Value OperationGenerator::generateBitwise(BinOp op, Value left, Value right) {
     switch (op) {
         case BinOp::Band:
-            m_Output << "\tand rax, rbx\n";
-            break;
+            return { m_Builder->value(IROp::And, IRType::Int, left.reg, right.reg) };
         case BinOp::Bor:
-            m_Output << "\tor rax, rbx\n";
-            break;
+            return { m_Builder->value(IROp::Or, IRType::Int, left.reg, right.reg) };
         case BinOp::Xor:
-            m_Output << "\txor rax, rbx\n";
-            break;
+            return { m_Builder->value(IROp::Xor, IRType::Int, left.reg, right.reg) };
+        default:
+            return {};
+    }
+}
+
+CmpOp OperationGenerator::comparison(const BinOp op) {
+    switch (op) {
+        case BinOp::Eq: return CmpOp::Eq;
+        case BinOp::Neq: return CmpOp::Ne;
+        case BinOp::Lt: return CmpOp::Lt;
+        case BinOp::Le: return CmpOp::Le;
+        case BinOp::Gt: return CmpOp::Gt;
+        case BinOp::Ge: return CmpOp::Ge;
+        default: return CmpOp::Eq;
     }
-}
\ No newline at end of file
+}
+
+VReg OperationGenerator::scalar(const Value value, const VarType type) {
+    return (type == VarType::String) ? value.len : value.reg;
+}
+
+Value OperationGenerator::callRuntime(const RuntimeFn function, const std::vector<VReg>& args) {
+    IRFunction& fn = m_Builder->fn();
+    const Value result{ fn.newVReg(IRType::Ptr), fn.newVReg(IRType::Int) };
+    m_Builder->emit(IRInst{
+        .op = IROp::CallRuntime,
+        .dst = result.reg,
+        .dst2 = result.len,
+        .imm = static_cast<int64_t>(function),
+        .argBegin = fn.addArgs(args),
+        .argCount = static_cast<uint32_t>(args.size()),
+    });
+    return result;
+}
@@ -1,45 +1,37 @@
 #include "Parser.hpp"
 #include <iostream>
+#include <charconv>
 
-Parser::Parser(std::vector<Token> tokens) : m_Tokens(std::move(tokens)), m_Allocator(1024 * 1024 * 4) /* 4 mb */ {
+Parser::Parser(Tokenizer& tokenizer) : m_Tokens(tokenizer) {
 
 }
 
-std::optional<NodeTerm*> Parser::parseTerm() {
+std::optional<NodeIndex> Parser::parseTerm() {
     if(const auto intLit = tryConsume(TokenType::int_lit)) {
-        NodeTermIntLit* termIntLit = m_Allocator.alloc<NodeTermIntLit>();
-        termIntLit->int_lit = intLit.value();
+        const std::string_view digits = intLit->value;
+        uint64_t value = 0;
+        std::from_chars(digits.data(), digits.data() + digits.size(), value);
 
-        NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-        term->var = termIntLit;
-        return term;
-    } 
+        return m_Ast.addNode(NodeKind::IntLit, 0, { static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32) });
+    }
 
     if (const auto ident = tryConsume(TokenType::ident)) {
         if (tryConsume(TokenType::open_paren)) {
             // thingy call
-            NodeTermCall* termCall = m_Allocator.alloc<NodeTermCall>();
-            termCall->ident = ident.value();
-
+            const size_t mark = m_Scratch.size();
             while(const auto expr = parseExpr()) {
-                termCall->args.push_back(expr.value());
+                m_Scratch.push_back(expr.value());
                 if(!tryConsume(TokenType::comma)) {
                     break;
                 }
             }
+            const NodeData args = commitScratch(mark);
 
             tryConsumeErr(TokenType::close_paren);
-            NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-            term->var = termCall;
-            return term;
+            return m_Ast.addNode(NodeKind::Call, ident->id, args);
         }
 
-        NodeTermIdent* termIdent = m_Allocator.alloc<NodeTermIdent>();
-        termIdent->ident = ident.value();
-
-        NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-        term->var = termIdent;
-        return term;
+        return m_Ast.addNode(NodeKind::Ident, ident->id);
     }
 
     if (const auto openParen = tryConsume(TokenType::open_paren)) {
@@ -49,49 +41,34 @@ std::optional<NodeTerm*> Parser::parseTerm() {
         }
 
         tryConsumeErr(TokenType::close_paren);
-        NodeTermParen* termParen = m_Allocator.alloc<NodeTermParen>();
-        termParen->expr = expr.value();
-
-        NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-        term->var = termParen;
-        return term;
+        // parentheses only group, the tree shape already records them
+        return expr.value();
     }
 
     if(const auto _bool = tryConsume(TokenType::_bool)) {
-        NodeTermBool* termBool = m_Allocator.alloc<NodeTermBool>();
-        termBool->_bool = _bool.value();
-
-        NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-        term->var = termBool;
-        return term;
+        return m_Ast.addNode(NodeKind::Bool, 0, { _bool->value == "1" ? 1u : 0u, 0 });
     }
 
     if (const auto string = tryConsume(TokenType::string)) {
-        NodeTermString* termString = m_Allocator.alloc<NodeTermString>();
-        termString->string = string.value();
-
-        NodeTerm* term = m_Allocator.alloc<NodeTerm>();
-        term->var = termString;
-        return term;
+        return m_Ast.addNode(NodeKind::String, m_Ast.addString(string->value));
     }
 
 
     return {};
 }
 
-std::optional<NodeExpr*> Parser::parseExpr(const int minPrec /*=0*/) {
+std::optional<NodeIndex> Parser::parseExpr(const int minPrec /*=0*/) {
     auto termLeft = parseTerm();
     if(!termLeft.has_value()) {
         return {};
     }
 
-    auto exprLeft = m_Allocator.alloc<NodeExpr>();
-    exprLeft->var = termLeft.value();
+    NodeIndex exprLeft = termLeft.value();
 
     while(true) {
-        auto currToken = peek();
+        const Token* currToken = peek();
         std::optional<int> prec;
-        if(!currToken.has_value()) {
+        if(!currToken) {
             break;
         }
 
@@ -100,7 +77,7 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec /*=0*/) {
             break;
         }
 
-        const Token& op = consume();
+        const Token op = consume();
         const int nextMinPrec = prec.value() + 1;
         auto exprRight = parseExpr(nextMinPrec);
         if(!exprRight.has_value()) {
@@ -108,86 +85,78 @@ std::optional<NodeExpr*> Parser::parseExpr(const int minPrec /*=0*/) {
         }
 
         // find binary operator
-        auto it = tokenTypeToBinOp.find(op.type);
-        if(it == tokenTypeToBinOp.end()) {
+        const auto binOp = tokenTypeToBinOp(op.type);
+        if(!binOp.has_value()) {
             errorExpected("binary operator");
         }
 
-        NodeBinExpr* binExpr = m_Allocator.alloc<NodeBinExpr>();
-        binExpr->op = it->second;
-        binExpr->left = exprLeft;
-        binExpr->right =  exprRight.value();
-
-        NodeExpr* newExpr = m_Allocator.alloc<NodeExpr>();
-        newExpr->var = binExpr;
-        exprLeft = newExpr;
+        exprLeft = m_Ast.addNode(NodeKind::BinExpr, static_cast<uint32_t>(binOp.value()), { exprLeft, exprRight.value() });
     }
 
     return exprLeft;
 }
 
-std::optional<NodeScope*> Parser::parseScope() {
+std::optional<NodeIndex> Parser::parseScope() {
     if(!tryConsume(TokenType::open_curly).has_value()) {
         return {};
     }
 
-    NodeScope* scope = m_Allocator.alloc<NodeScope>();
+    const size_t mark = m_Scratch.size();
     while(auto stmt = parseStmt()) {
-        scope->stmts.push_back(stmt.value());
+        m_Scratch.push_back(stmt.value());
     }
+    const NodeData stmts = commitScratch(mark);
 
     tryConsumeErr(TokenType::close_curly);
 
-    return scope;
+    return m_Ast.addNode(NodeKind::Scope, 0, stmts);
 }
 
-std::optional<NodeMaybePred*> Parser::parseMaybePred() {
+std::optional<NodeIndex> Parser::parseMaybePred() {
     if(tryConsume(TokenType::but)) {
         tryConsumeErr(TokenType::open_paren);
-        const auto but = m_Allocator.alloc<NodeMaybePredBut>();
+        NodeIndex cond = NoNode;
         if(const auto expr = parseExpr()) {
-            but->expr = expr.value();
+            cond = expr.value();
         } else {
             errorExpected("expression");
         }
 
         tryConsumeErr(TokenType::close_paren);
 
-        if(const auto scope = parseScope()) {
-            but->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if(const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             errorExpected("scope");
         }
 
-        but->pred = parseMaybePred();
-        const auto pred = m_Allocator.alloc<NodeMaybePred>();
-        pred->var = but;
-        return pred;
+        const NodeIndex pred = parseMaybePred().value_or(NoNode);
+        const uint32_t rest[] = { scope, pred };
+        return m_Ast.addNode(NodeKind::But, 0, { cond, m_Ast.addExtra(rest) });
     }
 
     if(tryConsume(TokenType::nah)) {
-        const auto nah = m_Allocator.alloc<NodeMaybePredNah>();
-        if(const auto scope = parseScope()) {
-            nah->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if(const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             errorExpected("scope");
         }
 
-        const auto pred = m_Allocator.alloc<NodeMaybePred>();
-        pred->var = nah;
-        return pred;
+        return m_Ast.addNode(NodeKind::Nah, 0, { scope, 0 });
     }
 
     return {};
 }
 
-std::optional<NodeStmt*> Parser::parseStmt() {
-    if(peek().has_value() && peek().value().type == TokenType::bye && peek(1).has_value() && peek(1).value().type == TokenType::open_paren) {
+std::optional<NodeIndex> Parser::parseStmt() {
+    if(peek() && peek()->type == TokenType::bye && peek(1) && peek(1)->type == TokenType::open_paren) {
         consume(); // bye
         consume(); // open paren
-        NodeStmtBye* bye = m_Allocator.alloc<NodeStmtBye>();
-        if(const auto expr = parseExpr()) {
-            bye->expr = expr.value();
+        NodeIndex expr = NoNode;
+        if(const auto parsed = parseExpr()) {
+            expr = parsed.value();
         } else {
             errorExpected("expression");
         }
@@ -195,171 +164,124 @@ std::optional<NodeStmt*> Parser::parseStmt() {
         tryConsumeErr(TokenType::close_paren);
         tryConsumeErr(TokenType::semi);
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = bye;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Bye, 0, { expr, 0 });
     }
-    
-    if (peek().has_value() && peek().value().type == TokenType::gimme) {
+
+    if (peek() && peek()->type == TokenType::gimme) {
         consume(); // gimme
-        NodeStmtGimme* gimme = m_Allocator.alloc<NodeStmtGimme>();
-        gimme->ident = tryConsumeErr(TokenType::ident);
-        
+        const Token ident = tryConsumeErr(TokenType::ident);
+
         tryConsumeErr(TokenType::colon);
-        NodeType* type = m_Allocator.alloc<NodeType>();
-        
-        auto typeToken = peek();
-        if (!typeToken.has_value() || (
-            typeToken.value().type != TokenType::type_number &&
-            typeToken.value().type != TokenType::type_string &&
-            typeToken.value().type != TokenType::type_bool
-        )) {
-            errorExpected("type (number, str, or bool)");
-        }
-        type->type = consume().type;
-        gimme->type = type;
-        
+        const TokenType type = consumeType("type (number, str, or bool)");
+
         tryConsumeErr(TokenType::eq);
 
-        if(const auto expr = parseExpr()) {
-            gimme->expr = expr.value();
+        NodeIndex expr = NoNode;
+        if(const auto parsed = parseExpr()) {
+            expr = parsed.value();
         } else {
             errorExpected("expression");
         }
         tryConsumeErr(TokenType::semi);
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = gimme;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Gimme, ident.id, { expr, static_cast<uint32_t>(type) });
     }
 
-    if (peek().has_value() && peek().value().type == TokenType::ident
-        && peek(1).has_value() && peek(1).value().type == TokenType::eq
+    if (peek() && peek()->type == TokenType::ident
+        && peek(1) && peek(1)->type == TokenType::eq
     ) {
-        NodeStmtAssignment* assignment = m_Allocator.alloc<NodeStmtAssignment>();
-        assignment->ident = consume();
+        const Token ident = consume();
         consume(); // eq
-        
-        if(const auto expr = parseExpr()) {
-            assignment->expr = expr.value();
+
+        NodeIndex expr = NoNode;
+        if(const auto parsed = parseExpr()) {
+            expr = parsed.value();
         } else {
             errorExpected("expression");
         }
         tryConsumeErr(TokenType::semi);
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = assignment;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Assignment, ident.id, { expr, 0 });
     }
-    
-    if (peek().has_value() && peek().value().type == TokenType::open_curly) {
+
+    if (peek() && peek()->type == TokenType::open_curly) {
         if(const auto scope = parseScope()) {
-            NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-            stmt->var = scope.value();
-            return stmt;
+            return scope.value();
         }
 
         errorExpected("scope");
     }
-    
+
     if (tryConsume(TokenType::maybe)) {
         tryConsumeErr(TokenType::open_paren);
-        NodeStmtMaybe* maybe = m_Allocator.alloc<NodeStmtMaybe>();
-        
+
+        NodeIndex cond = NoNode;
         if(const auto expr = parseExpr()) {
-            maybe->expr = expr.value();
+            cond = expr.value();
         } else {
             errorExpected("expression");
         }
-        
+
         tryConsumeErr(TokenType::close_paren);
 
-        if(const auto scope = parseScope()) {
-            maybe->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if(const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             errorExpected("scope");
         }
 
-        maybe->pred = parseMaybePred();
-
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = maybe;
-        return stmt;
+        const NodeIndex pred = parseMaybePred().value_or(NoNode);
+        const uint32_t rest[] = { scope, pred };
+        return m_Ast.addNode(NodeKind::Maybe, 0, { cond, m_Ast.addExtra(rest) });
     }
 
     if(tryConsume(TokenType::yell)) {
         tryConsumeErr(TokenType::open_paren);
-        NodeStmtYell* yell = m_Allocator.alloc<NodeStmtYell>();
-        if(const auto expr = parseExpr()) {
-            yell->expr = expr.value();
+        NodeIndex expr = NoNode;
+        if(const auto parsed = parseExpr()) {
+            expr = parsed.value();
         } else {
             errorExpected("expr");
         }
         tryConsumeErr(TokenType::close_paren);
         tryConsumeErr(TokenType::semi);
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = yell;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Yell, 0, { expr, 0 });
     }
 
     if(tryConsume(TokenType::thingy)) {
-        NodeStmtThingy* thingy = m_Allocator.alloc<NodeStmtThingy>();
-
-        Token name = tryConsumeErr(TokenType::ident);
-        thingy->name = name;
+        const Token name = tryConsumeErr(TokenType::ident);
 
         tryConsumeErr(TokenType::open_paren);
+        const size_t mark = m_Scratch.size();
         while(const auto ident = tryConsume(TokenType::ident)) {
-            NodeParam* param = m_Allocator.alloc<NodeParam>();
-            param->name = ident.value();
-
             tryConsumeErr(TokenType::colon);
-            NodeType* type = m_Allocator.alloc<NodeType>();
-            
-            auto typeToken = peek();
-            if (!typeToken.has_value() || (
-                typeToken.value().type != TokenType::type_number &&
-                typeToken.value().type != TokenType::type_string &&
-                typeToken.value().type != TokenType::type_bool
-            )) {
-                errorExpected("type (number, str or bool)");
-            }
-            type->type = consume().type;
-            param->type = type;
-            
-            thingy->params.push_back(param);
+            const TokenType type = consumeType("type (number, str or bool)");
+
+            m_Scratch.push_back(m_Ast.addNode(NodeKind::Param, ident->id, { 0, static_cast<uint32_t>(type) }));
             if(!tryConsume(TokenType::comma).has_value()) {
                 break;
             }
         }
+        const NodeData params = commitScratch(mark);
         tryConsumeErr(TokenType::close_paren);
 
         tryConsumeErr(TokenType::colon);
-        NodeType* returnType = m_Allocator.alloc<NodeType>();
-        auto typeToken = peek();
-        if (!typeToken.has_value() || (
-            typeToken.value().type != TokenType::type_number &&
-            typeToken.value().type != TokenType::type_string &&
-            typeToken.value().type != TokenType::type_bool
-        )) {
-            errorExpected("return type (number, str or bool)");
-        }
-        returnType->type = consume().type;
-        thingy->returnType = returnType;
-        
+        const TokenType returnType = consumeType("return type (number, str or bool)");
+
         m_FunctionDepth++;
-        if(const auto scope = parseScope()) {
-            thingy->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if(const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             m_FunctionDepth--;
             errorExpected("scope");
         }
         m_FunctionDepth--;
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = thingy;
-        return stmt;
+        const uint32_t proto[] = { params.lhs, params.rhs, static_cast<uint32_t>(returnType) };
+        return m_Ast.addNode(NodeKind::Thingy, name.id, { m_Ast.addExtra(proto), scope });
     }
 
     if(tryConsume(TokenType::gimmeback)) {
@@ -367,33 +289,28 @@ std::optional<NodeStmt*> Parser::parseStmt() {
             errorExpected("'gimmeback' inside of a function");
         }
 
-        NodeStmtGimmeback* gimmeback = m_Allocator.alloc<NodeStmtGimmeback>();
-
-        if(auto expr = parseExpr()) {
-            gimmeback->expr = expr.value();
+        NodeIndex expr = NoNode;
+        if(auto parsed = parseExpr()) {
+            expr = parsed.value();
         } else {
             errorExpected("expression");
         }
 
         tryConsumeErr(TokenType::semi);
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = gimmeback;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Gimmeback, 0, { expr, 0 });
     }
 
     if(tryConsume(TokenType::four)) {
-        NodeStmtFour* four = m_Allocator.alloc<NodeStmtFour>();
-        
         tryConsumeErr(TokenType::open_paren);
 
-        Token ident = tryConsumeErr(TokenType::ident);
-        four->ident = ident;
-        
+        const Token ident = tryConsumeErr(TokenType::ident);
+
         tryConsumeErr(TokenType::in);
 
-        if(const auto start = parseExpr()) {
-            four->start = start.value();
+        NodeIndex start = NoNode;
+        if(const auto parsed = parseExpr()) {
+            start = parsed.value();
         } else {
             errorExpected("expression");
         }
@@ -401,79 +318,76 @@ std::optional<NodeStmt*> Parser::parseStmt() {
         tryConsumeErr(TokenType::dot);
         tryConsumeErr(TokenType::dot);
 
-        if(const auto end = parseExpr()) {
-            four->end = end.value();
+        NodeIndex end = NoNode;
+        if(const auto parsed = parseExpr()) {
+            end = parsed.value();
         } else {
             errorExpected("expression");
         }
 
         tryConsumeErr(TokenType::close_paren);
 
-        if(const auto scope = parseScope()) {
-            four->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if(const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             errorExpected("scope");
         }
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = four;
-        return stmt;
+        const uint32_t bounds[] = { start, end };
+        return m_Ast.addNode(NodeKind::Four, ident.id, { m_Ast.addExtra(bounds), scope });
     }
 
     if(tryConsume(TokenType::why)) {
-        NodeStmtWhy* why = m_Allocator.alloc<NodeStmtWhy>();
-
         tryConsumeErr(TokenType::open_paren);
 
+        NodeIndex cond = NoNode;
         if (const auto expr = parseExpr()) {
-            why->expr = expr.value();
+            cond = expr.value();
         } else {
             errorExpected("expression");
         }
 
         tryConsumeErr(TokenType::close_paren);
 
-        if (const auto scope = parseScope()) {
-            why->scope = scope.value();
+        NodeIndex scope = NoNode;
+        if (const auto parsed = parseScope()) {
+            scope = parsed.value();
         } else {
             errorExpected("scope");
         }
 
-        NodeStmt* stmt = m_Allocator.alloc<NodeStmt>();
-        stmt->var = why;
-        return stmt;
+        return m_Ast.addNode(NodeKind::Why, 0, { cond, scope });
     }
 
     return {};
 }
 
-NodeProg Parser::parseProg() {
-    NodeProg prog;
-    while(peek().has_value()) {
+Ast Parser::parseProg() {
+    const NodeIndex root = m_Ast.addNode(NodeKind::Prog);
+    const size_t mark = m_Scratch.size();
+    while(peek()) {
         if (const auto stmt = parseStmt()) {
-            prog.stmts.push_back(stmt.value());
+            m_Scratch.push_back(stmt.value());
         } else {
             errorExpected("statement");
         }
     }
-    return prog;
+    m_Ast.setData(root, commitScratch(mark));
+    return std::move(m_Ast);
 }
 
 
-std::optional<Token> Parser::peek(const int offset /*=0*/) const {
-    if(m_Index + offset >= m_Tokens.size()) {
-        return {};
-    }
-
-    return m_Tokens.at(m_Index + offset);
+const Token* Parser::peek(const int offset /*=0*/) const {
+    return m_Tokens.peek(offset);
 }
 
 Token Parser::consume() {
-    return m_Tokens.at(m_Index++);
+    return m_Tokens.consume();
 }
 
 Token Parser::tryConsumeErr(const TokenType& type) {
-    if(peek().has_value() && peek().value().type == type) {
+    if(peek() && peek()->type == type) {
         return consume();
     }
 
@@ -482,29 +396,48 @@ Token Parser::tryConsumeErr(const TokenType& type) {
 }
 
 std::optional<Token> Parser::tryConsume(const TokenType& type) {
-    if(peek().has_value() && peek().value().type == type) {
+    if(peek() && peek()->type == type) {
         return consume();
     }
 
     return {};
 }
 
+TokenType Parser::consumeType(const std::string& what) {
+    const Token* typeToken = peek();
+    if (!typeToken || (
+        typeToken->type != TokenType::type_number &&
+        typeToken->type != TokenType::type_string &&
+        typeToken->type != TokenType::type_bool
+    )) {
+        errorExpected(what);
+    }
+    return consume().type;
+}
+
+NodeData Parser::commitScratch(const size_t mark) {
+    const std::span<const NodeIndex> items = std::span(m_Scratch).subspan(mark);
+    const uint32_t start = m_Ast.addExtra(items);
+    m_Scratch.resize(mark);
+    return { start, static_cast<uint32_t>(start + items.size()) };
+}
+
 void Parser::errorExpected(const std::string& msg) const {
-    const auto curr = peek(0);
-    const auto prev = peek(-1);
+    const Token* curr = peek(0);
+    const Token* prev = peek(-1);
 
-    if (curr.has_value()) {
+    if (curr) {
         // expected at current token
-        const Token& token = curr.value();
-        std::cerr << "[Parse Error] Expected " << msg << " but found " 
-                  << toString(token.type) << " at " << token.line 
+        const Token& token = *curr;
+        std::cerr << "[Parse Error] Expected " << msg << " but found "
+                  << toString(token.type) << " at " << token.line
                   << ":" << token.col << std::endl;
-    } else if (prev.has_value()) {
+    } else if (prev) {
         // eof reached
-        const Token& token = prev.value();
-        std::cerr << "[Parse Error] Expected " << msg << " after " 
-                  << token.line << ":" << token.col 
+        const Token& token = *prev;
+        std::cerr << "[Parse Error] Expected " << msg << " after "
+                  << token.line << ":" << token.col
                   << " (reached end of file)" << std::endl;
     }
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
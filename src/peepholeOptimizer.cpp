@@ -0,0 +1,244 @@
+#include "PeepholeOptimizer.hpp"
+
+#include <format>
+
+const PeepholeOptimizer::RuleEntry PeepholeOptimizer::s_Rules[] = {
+    { PeepholeRule::PushPop, "push/pop forwarding", &PeepholeOptimizer::pushPop },
+    { PeepholeRule::RedundantMove, "redundant move", &PeepholeOptimizer::redundantMove },
+    { PeepholeRule::ImmediateFold, "immediate folding", &PeepholeOptimizer::immediateFold },
+    { PeepholeRule::SetccBranch, "setcc branch", &PeepholeOptimizer::setccBranch },
+    { PeepholeRule::MergeRsp, "rsp adjustment merging", &PeepholeOptimizer::mergeRsp },
+};
+
+std::string PeepholeStats::report() const {
+    std::string out = "peephole:\n";
+    for (const auto& entry : PeepholeOptimizer::s_Rules) {
+        out += std::format("  {:<24} {}\n", entry.name, fired[static_cast<size_t>(entry.rule)]);
+    }
+    return out;
+}
+
+PeepholeOptimizer::PeepholeOptimizer(MFunction& function, PeepholeStats& stats) : m_Function(function), m_Stats(stats) {
+
+}
+
+void PeepholeOptimizer::run() {
+    std::vector<MInst>& insts = m_Function.insts;
+    m_Removed.assign(insts.size(), false);
+
+    // a rewrite can expose another one further up, so sweep until nothing fires
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        countRegisters();
+        for (size_t i = next(SIZE_MAX); i < insts.size(); i = next(i)) {
+            for (const RuleEntry& entry : s_Rules) {
+                if (!m_Removed[i] && (this->*entry.apply)(i)) {
+                    m_Stats.fired[static_cast<size_t>(entry.rule)]++;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < insts.size(); i++) {
+        if (!m_Removed[i]) {
+            insts[kept++] = insts[i];
+        }
+    }
+    insts.resize(kept);
+}
+
+bool PeepholeOptimizer::pushPop(const size_t i) {
+    const size_t j = next(i);
+    if (inst(i).op != MOp::Push || j == m_Function.insts.size() || inst(j).op != MOp::Pop) {
+        return false;
+    }
+
+    const Operand from = inst(i).dst;
+    const Operand to = inst(j).dst;
+    if (from.isMemory() && to.isMemory()) {
+        return false;
+    }
+    remove(j);
+    if (from == to) {
+        remove(i);
+    } else {
+        inst(i) = MInst{ .op = MOp::Mov, .dst = to, .src = from };
+    }
+    return true;
+}
+
+bool PeepholeOptimizer::redundantMove(const size_t i) {
+    const MInst& move = inst(i);
+    if (move.op != MOp::Mov && move.op != MOp::Lea) {
+        return false;
+    }
+
+    // mov x, x
+    if (move.op == MOp::Mov && move.dst == move.src) {
+        remove(i);
+        return true;
+    }
+    // a virtual register nothing reads
+    if (move.dst.isReg() && isVirtual(move.dst.reg) && m_Uses[move.dst.reg] == 0) {
+        remove(i);
+        return true;
+    }
+    // mov a, b; mov b, a
+    const size_t j = next(i);
+    if (move.op == MOp::Mov && move.dst.isReg() && move.src.isReg() && j < m_Function.insts.size()
+        && inst(j).op == MOp::Mov && inst(j).dst == move.src && inst(j).src == move.dst) {
+        remove(j);
+        return true;
+    }
+    return false;
+}
+
+bool PeepholeOptimizer::immediateFold(const size_t i) {
+    MInst& current = inst(i);
+    // push reads its only operand
+    Operand& source = (current.op == MOp::Push) ? current.dst : current.src;
+    if (!source.isReg() || !isVirtual(source.reg) || !m_Constants[source.reg].has_value()) {
+        return false;
+    }
+
+    const int64_t value = m_Constants[source.reg].value();
+    switch (current.op) {
+        case MOp::Mov:
+            // only a register takes a full 64-bit immediate
+            if (!current.dst.isReg() && !fitsImm32(value)) {
+                return false;
+            }
+            break;
+        case MOp::Add: case MOp::Sub: case MOp::Imul: case MOp::And: case MOp::Or: case MOp::Xor:
+        case MOp::Cmp: case MOp::Push:
+            if (!fitsImm32(value)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    use(source, -1);
+    source = Operand::imm(value);
+    return true;
+}
+
+bool PeepholeOptimizer::setccBranch(const size_t i) {
+    // setcc v; movzx v, v; cmp v, 0; je / jne -- the flags the setcc read still decide the branch
+    const MInst& setcc = inst(i);
+    if (setcc.op != MOp::Setcc || !isVirtual(setcc.dst.reg) || m_Uses[setcc.dst.reg] != 2) {
+        return false;
+    }
+    const Operand value = setcc.dst;
+    const size_t end = m_Function.insts.size();
+    const size_t zx = next(i);
+    const size_t cmp = zx < end ? next(zx) : end;
+    const size_t jcc = cmp < end ? next(cmp) : end;
+    if (jcc == end
+        || inst(zx).op != MOp::Movzx8 || inst(zx).dst != value || inst(zx).src != value
+        || inst(cmp).op != MOp::Cmp || inst(cmp).dst != value || inst(cmp).src != Operand::imm(0)
+        || inst(jcc).op != MOp::Jcc || (inst(jcc).cond != Cond::E && inst(jcc).cond != Cond::NE)) {
+        return false;
+    }
+
+    inst(jcc).cond = (inst(jcc).cond == Cond::NE) ? setcc.cond : invertCond(setcc.cond);
+    remove(cmp);
+    remove(zx);
+    remove(i);
+    return true;
+}
+
+bool PeepholeOptimizer::mergeRsp(const size_t i) {
+    const auto adjustment = [](const MInst& inst) -> std::optional<int64_t> {
+        if ((inst.op != MOp::Add && inst.op != MOp::Sub) || !inst.dst.isReg(PhysReg::rsp) || !inst.src.isImm()) {
+            return {};
+        }
+        return inst.op == MOp::Add ? inst.src.value : -inst.src.value;
+    };
+    const auto touchesStack = [](const MInst& inst) {
+        switch (inst.op) {
+            case MOp::Label: case MOp::Jmp: case MOp::Jcc: case MOp::Call: case MOp::TailCall: case MOp::Syscall: case MOp::Ret:
+            case MOp::Push: case MOp::Pop:
+                return true;
+            default: {
+                const auto stack = [](const Operand& operand) {
+                    return operand.kind == Operand::Kind::Slot
+                        || ((operand.isReg() || operand.kind == Operand::Kind::Mem) && operand.reg == toReg(PhysReg::rsp));
+                };
+                return stack(inst.dst) || stack(inst.src);
+            }
+        }
+    };
+
+    const std::optional<int64_t> first = adjustment(inst(i));
+    if (!first.has_value()) {
+        return false;
+    }
+
+    // slide over everything that leaves rsp alone up to the next adjustment
+    for (size_t j = next(i); j < m_Function.insts.size(); j = next(j)) {
+        const std::optional<int64_t> second = adjustment(inst(j));
+        if (second.has_value()) {
+            const int64_t total = first.value() + second.value();
+            remove(j);
+            if (total == 0) {
+                remove(i);
+            } else {
+                inst(i).op = total > 0 ? MOp::Add : MOp::Sub;
+                inst(i).src = Operand::imm(total > 0 ? total : -total);
+            }
+            return true;
+        }
+        if (touchesStack(inst(j))) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void PeepholeOptimizer::countRegisters() {
+    m_Uses.assign(m_Function.nextVReg, 0);
+    m_Defs.assign(m_Function.nextVReg, 0);
+    m_Constants.assign(m_Function.nextVReg, std::nullopt);
+    const std::vector<MInst>& insts = m_Function.insts;
+    for (size_t i = 0; i < insts.size(); i++) {
+        if (m_Removed[i]) {
+            continue;
+        }
+        forEachUse(insts[i], [&](const MReg reg) { m_Uses[reg]++; });
+        forEachDef(insts[i], [&](const MReg reg) { m_Defs[reg]++; });
+    }
+
+    // a single definition comes before every use of the register
+    for (size_t i = 0; i < insts.size(); i++) {
+        const MInst& move = insts[i];
+        if (!m_Removed[i] && move.op == MOp::Mov && move.dst.isReg() && isVirtual(move.dst.reg)
+            && move.src.isImm() && m_Defs[move.dst.reg] == 1) {
+            m_Constants[move.dst.reg] = move.src.value;
+        }
+    }
+}
+
+size_t PeepholeOptimizer::next(size_t i) const {
+    // SIZE_MAX wraps around to the first instruction
+    do {
+        i++;
+    } while (i < m_Removed.size() && m_Removed[i]);
+    return i;
+}
+
+void PeepholeOptimizer::remove(const size_t i) {
+    const MInst& removed = inst(i);
+    forEachUse(removed, [&](const MReg reg) { m_Uses[reg]--; });
+    m_Removed[i] = true;
+}
+
+void PeepholeOptimizer::use(const Operand& operand, const int delta) {
+    if (operand.isReg() || operand.kind == Operand::Kind::Mem) {
+        m_Uses[operand.reg] += delta;
+    }
+}
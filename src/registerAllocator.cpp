@@ -0,0 +1,444 @@
+#include "RegisterAllocator.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    // caller-saved registers first, a value that does not live across a call never costs a save
+    constexpr PhysReg allocOrder[] = {
+        PhysReg::rax, PhysReg::rcx, PhysReg::rdx, PhysReg::rsi, PhysReg::rdi, PhysReg::r8, PhysReg::r9,
+        PhysReg::rbx, PhysReg::r12, PhysReg::r13, PhysReg::r14, PhysReg::r15,
+    };
+
+    bool isCalleeSaved(const PhysReg reg) {
+        return reg == PhysReg::rbx || reg >= PhysReg::r12;
+    }
+
+    // registers the allocator never hands out and therefore does not track
+    bool isReserved(const MReg reg) {
+        return reg == toReg(PhysReg::rsp) || reg == toReg(PhysReg::rbp)
+            || reg == toReg(PhysReg::r10) || reg == toReg(PhysReg::r11);
+    }
+
+    bool readsDst(const MOp op) {
+        switch (op) {
+            case MOp::Mov: case MOp::Lea: case MOp::LeaScaled: case MOp::Setcc: case MOp::Movzx8: case MOp::Pop:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    bool writesDst(const MOp op) {
+        switch (op) {
+            case MOp::Mov: case MOp::Lea: case MOp::LeaScaled: case MOp::Setcc: case MOp::Movzx8: case MOp::Pop:
+            case MOp::Add: case MOp::Sub: case MOp::Imul: case MOp::And: case MOp::Or: case MOp::Xor:
+            case MOp::Shl: case MOp::Shr:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool acceptsMemorySrc(const MOp op) {
+        switch (op) {
+            case MOp::Mov: case MOp::Add: case MOp::Sub: case MOp::Imul: case MOp::And: case MOp::Or: case MOp::Xor: case MOp::Cmp:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // with a register or 32-bit immediate source
+    bool acceptsMemoryDst(const MOp op) {
+        switch (op) {
+            case MOp::Mov: case MOp::Add: case MOp::Sub: case MOp::And: case MOp::Or: case MOp::Xor: case MOp::Cmp:
+            case MOp::Shl: case MOp::Shr: case MOp::Push: case MOp::Pop: case MOp::Mul: case MOp::Div:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+RegisterAllocator::RegisterAllocator(MFunction& function) : m_Function(function) {
+
+}
+
+void RegisterAllocator::run() {
+    buildBlocks();
+    computeLiveness();
+    buildFixedRanges();
+    linearScan();
+    rewrite();
+    insertFrame();
+}
+
+void RegisterAllocator::buildBlocks() {
+    const std::vector<MInst>& insts = m_Function.insts;
+    std::unordered_map<uint32_t, uint32_t> labelBlocks;
+
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i < insts.size(); i++) {
+        if (insts[i].op == MOp::Label && i != begin) {
+            m_Blocks.push_back(Block{ begin, i, {} });
+            begin = i;
+        }
+        if (insts[i].op == MOp::Label) {
+            labelBlocks[static_cast<uint32_t>(insts[i].dst.value)] = static_cast<uint32_t>(m_Blocks.size());
+        }
+        if (insts[i].op == MOp::Jcc || isTerminator(insts[i])) {
+            m_Blocks.push_back(Block{ begin, i + 1, {} });
+            begin = i + 1;
+        }
+    }
+    if (begin != insts.size()) {
+        m_Blocks.push_back(Block{ begin, static_cast<uint32_t>(insts.size()), {} });
+    }
+
+    for (uint32_t b = 0; b < m_Blocks.size(); b++) {
+        const MInst& last = insts[m_Blocks[b].end - 1];
+        if (last.op == MOp::Jmp || last.op == MOp::Jcc) {
+            m_Blocks[labelBlocks.at(static_cast<uint32_t>(last.dst.value))].preds.push_back(b);
+        }
+        if (!isTerminator(last) && b + 1 < m_Blocks.size()) {
+            m_Blocks[b + 1].preds.push_back(b);
+        }
+    }
+}
+
+void RegisterAllocator::computeLiveness() {
+    const std::vector<MInst>& insts = m_Function.insts;
+    const uint32_t vregCount = m_Function.nextVReg - FirstVirtual;
+    m_Intervals.assign(vregCount, Interval{});
+
+    // (vreg, block) pairs: blocks reading a vreg before writing it, and blocks writing it
+    std::vector<std::pair<uint32_t, uint32_t>> upwardUses;
+    std::vector<std::pair<uint32_t, uint32_t>> defs;
+    std::vector<uint32_t> defStamp(vregCount, s_None);
+    std::vector<uint32_t> useStamp(vregCount, s_None);
+
+    for (uint32_t b = 0; b < m_Blocks.size(); b++) {
+        for (uint32_t i = m_Blocks[b].begin; i < m_Blocks[b].end; i++) {
+            const MInst& inst = insts[i];
+            forEachUse(inst, [&](const MReg reg) {
+                if (!isVirtual(reg)) {
+                    return;
+                }
+                extend(reg, 2 * i);
+                const uint32_t v = reg - FirstVirtual;
+                if (defStamp[v] != b && useStamp[v] != b) {
+                    useStamp[v] = b;
+                    upwardUses.emplace_back(v, b);
+                }
+            });
+            forEachDef(inst, [&](const MReg reg) {
+                if (!isVirtual(reg)) {
+                    return;
+                }
+                extend(reg, 2 * i + 1);
+                const uint32_t v = reg - FirstVirtual;
+                if (defStamp[v] != b) {
+                    defStamp[v] = b;
+                    defs.emplace_back(v, b);
+                }
+            });
+
+            if (inst.op == MOp::Mov && inst.dst.isReg() && inst.src.isReg()) {
+                if (isVirtual(inst.dst.reg)) {
+                    interval(inst.dst.reg).hint = inst.src.reg;
+                } else if (isVirtual(inst.src.reg)) {
+                    interval(inst.src.reg).hint = inst.dst.reg;
+                }
+            }
+        }
+    }
+
+    std::sort(upwardUses.begin(), upwardUses.end());
+    std::sort(defs.begin(), defs.end());
+
+    // walk backwards from every upward exposed use until a block that writes the vreg,
+    // the interval grows to cover each block the value flows through
+    std::vector<uint32_t> defines(m_Blocks.size(), s_None);
+    std::vector<uint32_t> liveIn(m_Blocks.size(), s_None);
+    std::vector<uint32_t> liveOut(m_Blocks.size(), s_None);
+    std::vector<uint32_t> worklist;
+    size_t d = 0;
+    for (size_t u = 0; u < upwardUses.size();) {
+        const uint32_t v = upwardUses[u].first;
+        while (d < defs.size() && defs[d].first < v) {
+            d++;
+        }
+        for (; d < defs.size() && defs[d].first == v; d++) {
+            defines[defs[d].second] = v;
+        }
+        for (; u < upwardUses.size() && upwardUses[u].first == v; u++) {
+            worklist.push_back(upwardUses[u].second);
+        }
+
+        const MReg reg = v + FirstVirtual;
+        while (!worklist.empty()) {
+            const uint32_t b = worklist.back();
+            worklist.pop_back();
+            if (liveIn[b] == v) {
+                continue;
+            }
+            liveIn[b] = v;
+            extend(reg, 2 * m_Blocks[b].begin);
+
+            for (const uint32_t pred : m_Blocks[b].preds) {
+                if (liveOut[pred] == v) {
+                    continue;
+                }
+                liveOut[pred] = v;
+                extend(reg, 2 * m_Blocks[pred].end - 1);
+                if (defines[pred] != v) {
+                    worklist.push_back(pred);
+                }
+            }
+        }
+    }
+}
+
+void RegisterAllocator::buildFixedRanges() {
+    const std::vector<MInst>& insts = m_Function.insts;
+    for (uint32_t i = 0; i < insts.size(); i++) {
+        forEachUse(insts[i], [&](const MReg reg) {
+            if (isVirtual(reg) || isReserved(reg)) {
+                return;
+            }
+            std::vector<Range>& ranges = m_Fixed[reg];
+            if (ranges.empty()) {
+                ranges.push_back(Range{ 0, 2 * i });
+            } else {
+                ranges.back().end = 2 * i;
+            }
+        });
+        forEachDef(insts[i], [&](const MReg reg) {
+            if (!isVirtual(reg) && !isReserved(reg)) {
+                m_Fixed[reg].push_back(Range{ 2 * i + 1, 2 * i + 1 });
+            }
+        });
+    }
+}
+
+void RegisterAllocator::linearScan() {
+    std::vector<MReg> order;
+    for (uint32_t v = 0; v < m_Intervals.size(); v++) {
+        if (m_Intervals[v].start != s_None) {
+            order.push_back(v + FirstVirtual);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const MReg a, const MReg b) {
+        return interval(a).start < interval(b).start;
+    });
+
+    std::vector<MReg> active;
+    for (const MReg reg : order) {
+        Interval& current = interval(reg);
+        std::erase_if(active, [&](const MReg other) { return interval(other).end < current.start; });
+
+        int8_t chosen = -1;
+        if (current.hint != s_None) {
+            const int8_t hinted = isVirtual(current.hint) ? interval(current.hint).phys : static_cast<int8_t>(current.hint);
+            if (hinted >= 0 && !isReserved(static_cast<MReg>(hinted)) && isFree(static_cast<PhysReg>(hinted), current, active)) {
+                chosen = hinted;
+            }
+        }
+        for (size_t i = 0; chosen < 0 && i < std::size(allocOrder); i++) {
+            if (isFree(allocOrder[i], current, active)) {
+                chosen = static_cast<int8_t>(allocOrder[i]);
+            }
+        }
+
+        if (chosen < 0) {
+            // evict the active interval that reaches furthest, if that beats spilling this one
+            MReg victim = s_None;
+            for (const MReg other : active) {
+                const Interval& candidate = interval(other);
+                if (fixedConflict(static_cast<PhysReg>(candidate.phys), current.start, current.end)) {
+                    continue;
+                }
+                if (victim == s_None || candidate.end > interval(victim).end) {
+                    victim = other;
+                }
+            }
+
+            if (victim != s_None && interval(victim).end > current.end) {
+                Interval& spilled = interval(victim);
+                chosen = spilled.phys;
+                spilled.phys = -1;
+                spilled.slot = m_Function.newSlot();
+                std::erase(active, victim);
+            } else {
+                current.slot = m_Function.newSlot();
+                continue;
+            }
+        }
+
+        current.phys = chosen;
+        active.push_back(reg);
+        const auto phys = static_cast<PhysReg>(chosen);
+        if (isCalleeSaved(phys) && std::find(m_SavedRegs.begin(), m_SavedRegs.end(), phys) == m_SavedRegs.end()) {
+            m_SavedRegs.push_back(phys);
+        }
+    }
+}
+
+void RegisterAllocator::rewrite() {
+    const auto isSpilled = [&](const Operand& operand) {
+        return operand.isReg() && isVirtual(operand.reg) && interval(operand.reg).slot != s_None;
+    };
+    const auto spillSlot = [&](const Operand& operand) {
+        return Operand::slot(interval(operand.reg).slot);
+    };
+
+    std::vector<MInst> out;
+    out.reserve(m_Function.insts.size());
+    for (const MInst& original : m_Function.insts) {
+        MInst inst = original;
+        const bool sameSpilled = isSpilled(inst.dst) && inst.src == inst.dst;
+        Operand reload;
+        Operand store;
+
+        if (isSpilled(inst.dst)) {
+            const Operand slot = spillSlot(inst.dst);
+            const bool srcFits = !inst.src.isMemory() && !isSpilled(inst.src) && (!inst.src.isImm() || fitsImm32(inst.src.value));
+            if (!sameSpilled && acceptsMemoryDst(inst.op) && srcFits) {
+                inst.dst = slot;
+            } else {
+                if (readsDst(inst.op) || sameSpilled) {
+                    out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::r(PhysReg::r11), .src = slot });
+                }
+                if (writesDst(inst.op)) {
+                    store = slot;
+                }
+                inst.dst = Operand::r(PhysReg::r11);
+                if (sameSpilled) {
+                    inst.src = inst.dst;
+                }
+            }
+        }
+
+        // x86 takes one memory operand, and only the second one for most of what we emit
+        if (isSpilled(inst.src)) {
+            if (acceptsMemorySrc(inst.op) && !inst.dst.isMemory()) {
+                inst.src = spillSlot(inst.src);
+            } else {
+                out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::r(PhysReg::r10), .src = spillSlot(inst.src) });
+                inst.src = Operand::r(PhysReg::r10);
+            }
+        }
+
+        inst.dst = assigned(inst.dst);
+        inst.src = assigned(inst.src);
+        if (inst.op == MOp::Mov && inst.dst.isReg() && inst.dst == inst.src) {
+            continue;
+        }
+        out.push_back(inst);
+
+        if (store.kind != Operand::Kind::None) {
+            out.push_back(MInst{ .op = MOp::Mov, .dst = store, .src = Operand::r(PhysReg::r11) });
+        }
+    }
+    m_Function.insts = std::move(out);
+}
+
+void RegisterAllocator::insertFrame() {
+    std::vector<uint32_t> saveSlots;
+    if (!m_Function.isEntry) {
+        for (size_t i = 0; i < m_SavedRegs.size(); i++) {
+            saveSlots.push_back(m_Function.newSlot());
+        }
+    }
+
+    // the frame is allocated once up front. rsp then only moves around calls that push arguments,
+    // everywhere else it stays put and the frame is addressed off it without setting up rbp
+    const bool framePointer = std::ranges::any_of(m_Function.insts, [](const MInst& inst) {
+        return inst.op == MOp::Push || inst.op == MOp::Pop || inst.dst.isReg(PhysReg::rsp);
+    });
+    const bool makesCalls = std::ranges::any_of(m_Function.insts, [](const MInst& inst) { return inst.op == MOp::Call; });
+
+    // a called function starts 8 off a 16 byte boundary because of its return address, _start starts on one
+    uint32_t frameSize = m_Function.slotCount * 8;
+    const uint32_t pushed = (m_Function.isEntry ? 0 : 8) + (framePointer ? 8 : 0);
+    if (makesCalls && (frameSize + pushed) % 16 != 0) {
+        frameSize += 8;
+    }
+    m_Function.frameSize = frameSize;
+
+    std::vector<MInst> out;
+    out.reserve(m_Function.insts.size() + 8);
+    if (framePointer) {
+        out.push_back(MInst{ .op = MOp::Push, .dst = Operand::r(PhysReg::rbp) });
+        out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::r(PhysReg::rbp), .src = Operand::r(PhysReg::rsp) });
+    }
+    if (frameSize > 0) {
+        out.push_back(MInst{ .op = MOp::Sub, .dst = Operand::r(PhysReg::rsp), .src = Operand::imm(frameSize) });
+    }
+    for (size_t i = 0; i < saveSlots.size(); i++) {
+        out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::slot(saveSlots[i]), .src = Operand::r(m_SavedRegs[i]) });
+    }
+
+    for (const MInst& inst : m_Function.insts) {
+        if (inst.op == MOp::Ret || inst.op == MOp::TailCall) {
+            for (size_t i = 0; i < saveSlots.size(); i++) {
+                out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::r(m_SavedRegs[i]), .src = Operand::slot(saveSlots[i]) });
+            }
+            if (framePointer) {
+                out.push_back(MInst{ .op = MOp::Mov, .dst = Operand::r(PhysReg::rsp), .src = Operand::r(PhysReg::rbp) });
+                out.push_back(MInst{ .op = MOp::Pop, .dst = Operand::r(PhysReg::rbp) });
+            } else if (frameSize > 0) {
+                out.push_back(MInst{ .op = MOp::Add, .dst = Operand::r(PhysReg::rsp), .src = Operand::imm(frameSize) });
+            }
+        }
+        out.push_back(inst);
+    }
+
+    // slots sit right below the saved rbp, or below the return address when there is none.
+    // stack arguments were addressed off rbp, which would sit 8 below the return address
+    const auto place = [&](Operand& operand) {
+        if (operand.kind == Operand::Kind::Slot) {
+            const int64_t offset = -8 * (operand.value + 1);
+            operand = framePointer ? Operand::mem(PhysReg::rbp, offset) : Operand::mem(PhysReg::rsp, frameSize + offset);
+        } else if (!framePointer && operand.kind == Operand::Kind::Mem && operand.reg == toReg(PhysReg::rbp)) {
+            operand = Operand::mem(PhysReg::rsp, operand.value + frameSize - 8);
+        }
+    };
+    for (MInst& inst : out) {
+        place(inst.dst);
+        place(inst.src);
+    }
+    m_Function.insts = std::move(out);
+}
+
+void RegisterAllocator::extend(const MReg reg, const uint32_t pos) {
+    Interval& current = interval(reg);
+    current.start = std::min(current.start, pos);
+    current.end = std::max(current.end, pos);
+}
+
+bool RegisterAllocator::isFree(const PhysReg reg, const Interval& current, const std::vector<MReg>& active) {
+    for (const MReg other : active) {
+        if (interval(other).phys == static_cast<int8_t>(reg)) {
+            return false;
+        }
+    }
+    return !fixedConflict(reg, current.start, current.end);
+}
+
+bool RegisterAllocator::fixedConflict(const PhysReg reg, const uint32_t start, const uint32_t end) const {
+    const std::vector<Range>& ranges = m_Fixed[static_cast<size_t>(reg)];
+    const auto it = std::lower_bound(ranges.begin(), ranges.end(), start,
+        [](const Range& range, const uint32_t pos) { return range.end < pos; });
+    return it != ranges.end() && it->start <= end;
+}
+
+Operand RegisterAllocator::assigned(const Operand& operand) {
+    if ((operand.isReg() || operand.kind == Operand::Kind::Mem) && isVirtual(operand.reg)) {
+        Operand result = operand;
+        result.reg = toReg(static_cast<PhysReg>(interval(operand.reg).phys));
+        return result;
+    }
+    return operand;
+}
@@ -0,0 +1,81 @@
+#include "SourceBuffer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::SourceBuffer(const std::string& path) {
+    const bool isStdin = path == "-";
+    const int fd = isStdin ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error(path, std::strerror(errno));
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        error(path, std::strerror(errno));
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        error(path, "is a directory");
+    }
+
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            m_Data = static_cast<const char*>(mapping);
+            m_Size = info.st_size;
+            m_Mapped = true;
+        }
+    }
+
+    if (!m_Mapped) {
+        // pipes, ttys, empty or unmappable files
+        readAll(fd, path);
+    }
+
+    if (!isStdin) {
+        close(fd);
+    }
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (m_Mapped) {
+        munmap(const_cast<char*>(m_Data), m_Size);
+    }
+}
+
+void SourceBuffer::readAll(const int fd, const std::string& path) {
+    m_Owned.resize(64 * 1024);
+    size_t used = 0;
+    while (true) {
+        if (used == m_Owned.size()) {
+            m_Owned.resize(m_Owned.size() * 2);
+        }
+
+        const ssize_t n = read(fd, m_Owned.data() + used, m_Owned.size() - used);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error(path, std::strerror(errno));
+        }
+        if (n == 0) {
+            break;
+        }
+        used += n;
+    }
+    m_Owned.resize(used);
+    m_Data = m_Owned.data();
+    m_Size = m_Owned.size();
+}
+
+void SourceBuffer::error(const std::string& path, const std::string& msg) {
+    std::cerr << "[Input Error] " << path << ": " << msg << std::endl;
+    exit(EXIT_FAILURE);
+}
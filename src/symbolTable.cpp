@@ -0,0 +1,70 @@
+#include "SymbolTable.hpp"
+
+SymbolTable::SymbolTable() : m_Slots(64) {
+
+}
+
+void SymbolTable::enterScope() {
+    m_ScopeMarks.push_back(static_cast<uint32_t>(m_Bindings.size()));
+}
+
+void SymbolTable::leaveScope() {
+    const uint32_t mark = m_ScopeMarks.back();
+    m_ScopeMarks.pop_back();
+
+    while (m_Bindings.size() > mark) {
+        const Binding& binding = m_Bindings.back();
+        m_Slots[findSlot(binding.key)].binding = binding.shadowed;
+        m_Bindings.pop_back();
+    }
+}
+
+bool SymbolTable::declare(const Namespace ns, const NameId name, const SymbolId symbol) {
+    const uint32_t key = makeKey(ns, name);
+    size_t index = findSlot(key);
+    if (m_Slots[index].key == s_Empty) {
+        if ((m_Used + 1) * 4 > m_Slots.size() * 3) {
+            grow();
+            index = findSlot(key);
+        }
+        m_Slots[index].key = key;
+        m_Used++;
+    }
+
+    Slot& slot = m_Slots[index];
+    const auto depth = static_cast<uint32_t>(m_ScopeMarks.size());
+    const bool fresh = slot.binding == s_Empty || m_Bindings[slot.binding].depth != depth;
+
+    m_Bindings.push_back(Binding{ .key = key, .symbol = symbol, .shadowed = slot.binding, .depth = depth });
+    slot.binding = static_cast<uint32_t>(m_Bindings.size() - 1);
+    return fresh;
+}
+
+SymbolId SymbolTable::lookup(const Namespace ns, const NameId name) const {
+    const Slot& slot = m_Slots[findSlot(makeKey(ns, name))];
+    if (slot.binding == s_Empty) {
+        return NoSymbol;
+    }
+    return m_Bindings[slot.binding].symbol;
+}
+
+size_t SymbolTable::findSlot(const uint32_t key) const {
+    // interned ids are dense, fibonacci hashing spreads neighbouring ids across the table
+    const size_t mask = m_Slots.size() - 1;
+    size_t index = (key * 0x9E3779B9u) >> m_Shift;
+    while (m_Slots[index].key != key && m_Slots[index].key != s_Empty) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old(m_Slots.size() * 2);
+    old.swap(m_Slots);
+    m_Shift--;
+    for (const Slot& slot : old) {
+        if (slot.key != s_Empty) {
+            m_Slots[findSlot(slot.key)] = slot;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include "TailCallEliminator.hpp"
+
+#include <algorithm>
+
+TailCallEliminator::TailCallEliminator(IRModule& module) : m_Module(module) {
+
+}
+
+void TailCallEliminator::run() {
+    for (size_t f = 0; f < m_Module.functions.size(); f++) {
+        IRFunction& function = m_Module.functions[f];
+        if (function.isEntry) {
+            continue;
+        }
+
+        std::vector<uint32_t> sites;
+        for (uint32_t b = 0; b < function.blocks.size(); b++) {
+            const std::vector<IRInst>& insts = function.blocks[b].insts;
+            if (insts.size() >= 2 && isTailCall(insts[insts.size() - 2], insts.back())
+                && static_cast<size_t>(insts[insts.size() - 2].imm) == f) {
+                sites.push_back(b);
+            }
+        }
+        if (!sites.empty()) {
+            eliminate(function, sites);
+        }
+    }
+}
+
+void TailCallEliminator::eliminate(IRFunction& function, const std::vector<uint32_t>& sites) {
+    // the entry block is split after the parameters are read, the rest becomes the block tail calls go to
+    std::vector<IRInst>& entry = function.blocks[0].insts;
+    const auto firstOther = std::ranges::find_if(entry, [](const IRInst& inst) { return inst.op != IROp::Param; });
+    const auto start = static_cast<uint32_t>(function.blocks.size());
+    IRBlock body{ .name = function.name + "_start", .insts = std::vector<IRInst>(firstOther, entry.end()) };
+    entry.erase(firstOther, entry.end());
+    entry.push_back(IRInst{ .op = IROp::Jmp, .target = start });
+
+    std::vector<VReg> params(function.paramSlots, NoVReg);
+    for (const IRInst& inst : entry) {
+        if (inst.op == IROp::Param) {
+            params[inst.imm] = inst.dst;
+        }
+    }
+
+    for (const uint32_t site : sites) {
+        std::vector<IRInst>& insts = function.blocks[site].insts;
+        const IRInst call = insts[insts.size() - 2];
+        insts.resize(insts.size() - 2);
+
+        // an argument may read a parameter assigned before it, those are copied out first
+        std::vector<VReg> values;
+        for (uint32_t i = 0; i < call.argCount; i++) {
+            const VReg arg = function.args[call.argBegin + i];
+            if (std::ranges::find(params, arg) == params.end()) {
+                values.push_back(arg);
+                continue;
+            }
+            const VReg copy = function.newVReg(function.types[arg]);
+            insts.push_back(IRInst{ .op = IROp::Copy, .dst = copy, .a = arg });
+            values.push_back(copy);
+        }
+        for (uint32_t slot = 0; slot < values.size(); slot++) {
+            if (params[slot] != NoVReg) {
+                insts.push_back(IRInst{ .op = IROp::Copy, .dst = params[slot], .a = values[slot] });
+            }
+        }
+        insts.push_back(IRInst{ .op = IROp::Jmp, .target = start });
+    }
+
+    // nothing may get back to reading the parameters again
+    for (IRBlock& block : function.blocks) {
+        IRInst& last = block.insts.back();
+        if ((last.op == IROp::Jmp || last.op == IROp::Br) && last.target == 0) {
+            last.target = start;
+        }
+        if (last.op == IROp::Br && last.elseTarget == 0) {
+            last.elseTarget = start;
+        }
+    }
+
+    function.blocks.push_back(std::move(body));
+    std::vector<uint32_t> order = { 0, start };
+    for (uint32_t b = 1; b < start; b++) {
+        order.push_back(b);
+    }
+    function.reorderBlocks(order);
+}
@@ -0,0 +1,37 @@
+#include "TokenStream.hpp"
+
+TokenStream::TokenStream(Tokenizer& tokenizer) : m_Tokenizer(tokenizer) {
+    fill();
+}
+
+const Token* TokenStream::peek(const int offset /*=0*/) const {
+    if (offset < -s_Behind || offset > s_Ahead) {
+        return nullptr;
+    }
+
+    const size_t pos = m_Index + offset;
+    if (pos >= m_Pulled) {
+        // past the end, or before the first token
+        return nullptr;
+    }
+
+    return &m_Ring[pos % s_Capacity];
+}
+
+Token TokenStream::consume() {
+    const Token token = m_Ring[m_Index % s_Capacity];
+    m_Index++;
+    fill();
+    return token;
+}
+
+void TokenStream::fill() {
+    while (!m_Exhausted && m_Pulled <= m_Index + s_Ahead) {
+        if (auto token = m_Tokenizer.next()) {
+            m_Ring[m_Pulled % s_Capacity] = token.value();
+            m_Pulled++;
+        } else {
+            m_Exhausted = true;
+        }
+    }
+}
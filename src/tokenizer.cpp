@@ -1,226 +1,161 @@
 #include "Tokenizer.hpp"
+#include "CharScan.hpp"
 #include <iostream>
+#include <charconv>
 
-Tokenizer::Tokenizer(std::string src): m_Src(std::move(src)) {
+Tokenizer::Tokenizer(const std::string_view src, Interner& interner): m_Src(src), m_Interner(interner) {
 
 }
 
-std::vector<Token> Tokenizer::tokenize() {
-    std::vector<Token> tokens;
-    std::string buf;
+std::optional<Token> Tokenizer::next() {
+    while(m_Index < m_Src.size()) {
+        const size_t start = m_Index;
+        const char c = peek();
+        if (scan::isSpace(c)) {
+            advanceTo(scan::skipWhitespace(cursor(), end()));
+        } else if(scan::isAlpha(c)) {
+            m_Index = scan::skipAlnum(cursor() + 1, end()) - m_Src.data();
 
-    while(peek().has_value()) {
-        if(std::isalpha(peek().value())) {
-            buf.push_back(consume());
-            while(peek().has_value() && std::isalnum(peek().value())) {
-                buf.push_back(consume());
-            }
+            const std::string_view buf = view(start);
 
-            if(buf == "bye") {
-                tokens.push_back({ TokenType::bye, m_Line, m_Col });
-            } else if (buf == "yell") {
-                tokens.push_back({ TokenType::yell, m_Line, m_Col });
-            } else if (buf == "gimme") {
-                tokens.push_back({ TokenType::gimme, m_Line, m_Col });
-            } else if (buf == "yep") {
-                tokens.push_back({ TokenType::_bool, m_Line, m_Col, "1" });
-            } else if (buf == "nope") {
-                tokens.push_back({ TokenType::_bool, m_Line, m_Col, "0" });
-            } else if (buf == "thingy") {
-                tokens.push_back({ TokenType::thingy, m_Line, m_Col });
-            } else if (buf == "gimmeback") {
-                tokens.push_back({ TokenType::gimmeback, m_Line, m_Col });
-            } else if (buf == "four") {
-                tokens.push_back({ TokenType::four, m_Line, m_Col });
-            } else if (buf == "in") {
-                tokens.push_back({ TokenType::in, m_Line, m_Col });
-            } else if (buf == "why") {
-                tokens.push_back({ TokenType::why, m_Line, m_Col });
-            } else if (buf == "maybe") {
-                tokens.push_back({ TokenType::maybe, m_Line, m_Col });
-            } else if (buf == "but") {
-                tokens.push_back({ TokenType::but, m_Line, m_Col });
-            } else if (buf == "nah") {
-                tokens.push_back({ TokenType::nah, m_Line, m_Col });
-            } else if (buf == "and") {
-                tokens.push_back({ TokenType::_and, m_Line, m_Col });
-            } else if (buf == "or") {
-                tokens.push_back({ TokenType::_or, m_Line, m_Col });
-            } else if (buf == "band") {
-                tokens.push_back({ TokenType::band, m_Line, m_Col });
-            } else if (buf == "bor") {
-                tokens.push_back({ TokenType::bor, m_Line, m_Col });
-            } else if (buf == "xor") {
-                tokens.push_back({ TokenType::_xor, m_Line, m_Col });
-            } else if (buf == "number") {
-                tokens.push_back({ TokenType::type_number, m_Line, m_Col });
-            } else if (buf == "str") {
-                tokens.push_back({ TokenType::type_string, m_Line, m_Col });
-            } else if (buf == "bool") {
-                tokens.push_back({ TokenType::type_bool, m_Line, m_Col });
-            } else {
-                tokens.push_back({ TokenType::ident, m_Line, m_Col, buf });
-            }
-            buf.clear();
-        } else if (std::isdigit(peek().value())) {
-            buf.push_back(consume());
-            while(peek().has_value() && std::isdigit(peek().value())) {
-                buf.push_back(consume());
+            if (const Keyword* keyword = findKeyword(buf)) {
+                return Token{ keyword->type, m_Line, col(), keyword->value };
             }
-            try {
-                std::stoll(buf);
-            } catch (const std::out_of_range&) {
-                std::cerr << "[Tokenize Error] Integer literal out of range at " << m_Line << ":" << m_Col << std::endl;
+            return Token{ TokenType::ident, m_Line, col(), buf, m_Interner.intern(buf) };
+        } else if (scan::isDigit(c)) {
+            m_Index = scan::skipDigits(cursor() + 1, end()) - m_Src.data();
+
+            const std::string_view buf = view(start);
+            long long parsed;
+            if (std::from_chars(buf.data(), buf.data() + buf.size(), parsed).ec == std::errc::result_out_of_range) {
+                std::cerr << "[Tokenize Error] Integer literal out of range at " << m_Line << ":" << col() << std::endl;
                 exit(EXIT_FAILURE);
             }
 
-            tokens.push_back({ TokenType::int_lit, m_Line, m_Col, buf });
-            buf.clear();
-        } else if(peek().value() == '/' && peek(1).has_value() && peek(1).value() == '/') {
-            consume();
-            consume();
-            while (peek().has_value() && peek().value() != '\n') {
-                consume();
+            return Token{ TokenType::int_lit, m_Line, col(), buf };
+        } else if(c == '/' && peek(1) == '/') {
+            // the newline itself is left for the whitespace skip
+            m_Index = scan::findChar(cursor() + 2, end(), '\n') - m_Src.data();
+        } else if(c == '/' && peek(1) == '*') {
+            const char* close = scan::findCommentEnd(cursor() + 2, end());
+            advanceTo(close);
+            if (close != end()) {
+                m_Index += 2;
             }
-        } else if(peek().value() == '/' && peek(1).has_value() && peek(1).value() == '*') {
+        } else if (c == '(') {
             consume();
+            return Token{ TokenType::open_paren, m_Line, col() };
+        } else if (c == ')') {
             consume();
-            while (peek().has_value()) {
-                if (peek().value() == '*' && peek(1).has_value() && peek(1).value() == '/') {
-                    consume();
-                    consume();
-                    break;
-                }
-                consume();
-            }
-        } else if (peek().value() == '(') {
-            consume();
-            tokens.push_back({ TokenType::open_paren, m_Line, m_Col });
-        } else if (peek().value() == ')') {
-            consume();
-            tokens.push_back({ TokenType::close_paren, m_Line, m_Col });
-        } else if (peek().value() == ';') {
+            return Token{ TokenType::close_paren, m_Line, col() };
+        } else if (c == ';') {
             consume();
-            tokens.push_back({ TokenType::semi, m_Line, m_Col });
-        } else if (peek().value() == '=') {
-            if (peek(1).has_value() && peek(1).value() == '=') {
+            return Token{ TokenType::semi, m_Line, col() };
+        } else if (c == '=') {
+            if (peek(1) == '=') {
                 consume();
                 consume();
-                tokens.push_back({ TokenType::eqeq, m_Line, m_Col });
-                continue;
+                return Token{ TokenType::eqeq, m_Line, col() };
             }
             consume();
-            tokens.push_back({ TokenType::eq, m_Line, m_Col });
-        } else if (peek().value() == '!') {
-            if(peek(1).has_value() && peek(1).value() == '=') {
+            return Token{ TokenType::eq, m_Line, col() };
+        } else if (c == '!') {
+            if(peek(1) == '=') {
                 consume();
                 consume();
-                tokens.push_back({ TokenType::neq, m_Line, m_Col });
-                continue;
+                return Token{ TokenType::neq, m_Line, col() };
             }
 
             std::cerr << "Invalid token(!)" << std::endl;
             exit(EXIT_FAILURE);
-        } else if (peek().value() == '"') {
+        } else if (c == '"' || c == '\'') {
             consume();
-            std::string buf;
-
-            while(peek().has_value()) {
-                if(peek().value() == '"') {
-                    consume();
-                    break;
-                }
-                buf += consume();
-            }
-
-            tokens.push_back({ TokenType::string, m_Line, m_Col, buf });
-        } else if (peek().value() == '\'') {
-            consume();
-            std::string buf;
-
-            while(peek().has_value()) {
-                if(peek().value() == '\'') {
-                    consume();
-                    break;
-                }
-                buf += consume();
+            const char* close = scan::findChar(cursor(), end(), c);
+            const std::string_view content(cursor(), close - cursor());
+            advanceTo(close);
+            if (close != end()) {
+                consume();
             }
 
-            tokens.push_back({ TokenType::string, m_Line, m_Col, buf });
-        } else if (peek().value() == '>') {
-            if (peek(1).has_value() && peek(1).value() == '=') {
+            return Token{ TokenType::string, m_Line, col(), content };
+        } else if (c == '>') {
+            if (peek(1) == '=') {
                 consume();
                 consume();
-                tokens.push_back({ TokenType::ge, m_Line, m_Col });
-                continue;
+                return Token{ TokenType::ge, m_Line, col() };
             }
             consume();
-            tokens.push_back({ TokenType::gt, m_Line, m_Col });
-        } else if (peek().value() == '<') {
-            if (peek(1).has_value() && peek(1).value() == '=') {
+            return Token{ TokenType::gt, m_Line, col() };
+        } else if (c == '<') {
+            if (peek(1) == '=') {
                 consume();
                 consume();
-                tokens.push_back({ TokenType::le, m_Line, m_Col });
-                continue;
+                return Token{ TokenType::le, m_Line, col() };
             }
             consume();
-            tokens.push_back({ TokenType::lt, m_Line, m_Col });
-        } else if (peek().value() == '+') {
+            return Token{ TokenType::lt, m_Line, col() };
+        } else if (c == '+') {
             consume();
-            tokens.push_back({ TokenType::plus, m_Line, m_Col });
-        } else if (peek().value() == '-') {
+            return Token{ TokenType::plus, m_Line, col() };
+        } else if (c == '-') {
             consume();
-            tokens.push_back({ TokenType::minus, m_Line, m_Col });
-        } else if (peek().value() == '*') {
+            return Token{ TokenType::minus, m_Line, col() };
+        } else if (c == '*') {
             consume();
-            tokens.push_back({ TokenType::star, m_Line, m_Col });
-        } else if (peek().value() == '/') {
+            return Token{ TokenType::star, m_Line, col() };
+        } else if (c == '/') {
             consume();
-            tokens.push_back({ TokenType::fslash, m_Line, m_Col });
-        } else if (peek().value() == '{') {
+            return Token{ TokenType::fslash, m_Line, col() };
+        } else if (c == '{') {
             consume();
-            tokens.push_back({ TokenType::open_curly, m_Line, m_Col });
-        } else if (peek().value() == '}') {
+            return Token{ TokenType::open_curly, m_Line, col() };
+        } else if (c == '}') {
             consume();
-            tokens.push_back({ TokenType::close_curly, m_Line, m_Col });
-        } else if (peek().value() == '.') {
+            return Token{ TokenType::close_curly, m_Line, col() };
+        } else if (c == '.') {
             consume();
-            tokens.push_back({ TokenType::dot, m_Line, m_Col });
-        } else if (peek().value() == ':') {
+            return Token{ TokenType::dot, m_Line, col() };
+        } else if (c == ':') {
             consume();
-            tokens.push_back({ TokenType::colon, m_Line, m_Col });
-        } else if (peek().value() == ',') {
-            consume();
-            tokens.push_back({ TokenType::comma, m_Line, m_Col });
-        } else if (peek().value() == '\n') {
-            consume();
-        } else if(std::isspace(peek().value())) {
+            return Token{ TokenType::colon, m_Line, col() };
+        } else if (c == ',') {
             consume();
+            return Token{ TokenType::comma, m_Line, col() };
         } else {
-            std::cerr << "[Tokenize Error] Invalid token at " << m_Line << ":" << m_Col << std::endl;
+            std::cerr << "[Tokenize Error] Invalid token at " << m_Line << ":" << col() << std::endl;
             exit(EXIT_FAILURE);
         }
-    }    
+    }
 
-    m_Index = 0;
-    return tokens;
+    return {};
 }
 
-std::optional<char> Tokenizer::peek(const size_t offset /*=0*/) const {
+char Tokenizer::peek(const size_t offset /*=0*/) const {
     if(m_Index + offset >= m_Src.size()) {
-        return {};
+        return '\0';
     }
 
-    return m_Src.at(m_Index + offset);
+    return m_Src[m_Index + offset];
 }
 
 char Tokenizer::consume() {
-    char c =  m_Src.at(m_Index++);
+    const char c = m_Src[m_Index++];
     if(c == '\n') {
         m_Line++;
-        m_Col = 1;
-    } else {
-        m_Col++;
+        m_LineStart = m_Index;
     }
     return c;
-}
\ No newline at end of file
+}
+
+void Tokenizer::advanceTo(const char* pos) {
+    const scan::NewlineCount newlines = scan::countNewlines(cursor(), pos);
+    if (newlines.count > 0) {
+        m_Line += newlines.count;
+        m_LineStart = newlines.last + 1 - m_Src.data();
+    }
+    m_Index = pos - m_Src.data();
+}
+
+std::string_view Tokenizer::view(const size_t start) const {
+    return m_Src.substr(start, m_Index - start);
+}
@@ -1,165 +1,347 @@
 #include "TypeChecker.hpp"
 #include <format>
+#include <iostream>
 
-TypeChecker::TypeChecker(const std::vector<Scope>& scopes) : m_Scopes(scopes) {
+TypeChecker::TypeChecker(const Ast& ast, const Interner& interner) : m_Ast(ast), m_Interner(interner) {
 
 }
 
-TypeInfo TypeChecker::checkExpr(const NodeExpr* expr) {
-    struct ExprTypeVisitor {
-        TypeChecker& checker;
-        TypeInfo operator()(const NodeTerm* term) const {
-            return checker.checkTerm(term);
-        }
-        TypeInfo operator()(const NodeBinExpr* binExpr) const {
-            return checker.checkBinExpr(binExpr);
-        }
-    };
-    
-    ExprTypeVisitor visitor{ *this };
-    return std::visit(visitor, expr->var);
-}
+Annotations TypeChecker::check() {
+    m_Result.types.assign(m_Ast.nodeCount(), VarType::Number);
+    m_Result.symbols.assign(m_Ast.nodeCount(), NoSymbol);
 
-TypeInfo TypeChecker::checkTerm(const NodeTerm* term) {
-    struct TermTypeVisitor {
-        TypeChecker& checker;
-        TypeInfo operator()(const NodeTermIntLit*) const {
-            return TypeInfo::valid(VarType::Number);
+    m_Symbols.enterScope();
+    const std::span<const NodeIndex> stmts = m_Ast.list(m_Ast.root());
+    // thingies are emitted before the main body, so they only see the thingies declared before them
+    for (const NodeIndex stmt : stmts) {
+        if (m_Ast.kind(stmt) == NodeKind::Thingy) {
+            checkThingy(stmt);
         }
-        TypeInfo operator()(const NodeTermBool*) const {
-            return TypeInfo::valid(VarType::Bool);
+    }
+    for (const NodeIndex stmt : stmts) {
+        if (m_Ast.kind(stmt) != NodeKind::Thingy) {
+            checkStmt(stmt);
         }
-        TypeInfo operator()(const NodeTermString*) const {
-            return TypeInfo::valid(VarType::String);
+    }
+    m_Symbols.leaveScope();
+
+    if (!m_Errors.empty()) {
+        for (const std::string& msg : m_Errors) {
+            std::cerr << "[Type Error] " << msg << std::endl;
         }
-        TypeInfo operator()(const NodeTermIdent* ident) const {
-            const Var* var = checker.lookupVar(ident->ident.value.value());
-            if (!var) {
-                return TypeInfo::error("Undeclared identifier: " + ident->ident.value.value());
+        exit(EXIT_FAILURE);
+    }
+
+    return std::move(m_Result);
+}
+
+std::optional<VarType> TypeChecker::checkExpr(const NodeIndex expr) {
+    if (m_Ast.kind(expr) == NodeKind::BinExpr) {
+        return annotate(expr, checkBinExpr(expr));
+    }
+    return annotate(expr, checkTerm(expr));
+}
+
+std::optional<VarType> TypeChecker::checkTerm(const NodeIndex term) {
+    switch (m_Ast.kind(term)) {
+        case NodeKind::IntLit:
+            return VarType::Number;
+        case NodeKind::Bool:
+            return VarType::Bool;
+        case NodeKind::String:
+            return VarType::String;
+        case NodeKind::Ident: {
+            const SymbolId var = resolveVar(m_Ast.name(term));
+            if (var == NoSymbol) {
+                return {};
             }
-            return TypeInfo::valid(var->type);
-        }
-        TypeInfo operator()(const NodeTermParen* paren) const {
-            return checker.checkExpr(paren->expr);
+            m_Result.symbols[term] = var;
+            return m_Result.symbolTable[var].type;
         }
-        TypeInfo operator()(const NodeTermCall* call) const {
-            const Thingy* thingy = checker.lookupThingy(call->ident.value.value());
-            if (!thingy) {
-                return TypeInfo::error("Undeclared function: " + call->ident.value.value());
+        case NodeKind::Call: {
+            const std::string_view name = m_Interner.name(m_Ast.name(term));
+            const std::span<const NodeIndex> args = m_Ast.list(term);
+            const SymbolId thingy = m_Symbols.lookup(SymbolTable::Namespace::Thingy, m_Ast.name(term));
+            if (thingy == NoSymbol) {
+                error(std::format("Undeclared function: {}", name));
+                for (const NodeIndex arg : args) {
+                    checkExpr(arg);
+                }
+                return {};
             }
+            m_Result.symbols[term] = thingy;
 
-            if (call->args.size() != thingy->paramTypes.size()) {
-                return TypeInfo::error(std::format("Argument count mismatch for function: {}. Expected: {}. Count: {}", call->ident.value.value(), thingy->paramTypes.size(), call->args.size()));
+            const Symbol& symbol = m_Result.symbolTable[thingy];
+            const std::span<const NodeIndex> params = m_Ast.proto(symbol.decl).params;
+            if (args.size() != params.size()) {
+                error(std::format("Argument count mismatch for function: {}. Expected: {}. Count: {}", name, params.size(), args.size()));
             }
 
-            for(size_t i = 0; i < call->args.size(); i++) {
-                TypeInfo argType = checker.checkExpr(call->args[i]);
-                if(!argType.isValid) {
-                    return argType;
+            for(size_t i = 0; i < args.size(); i++) {
+                const std::optional<VarType> argType = checkExpr(args[i]);
+                if (!argType.has_value() || i >= params.size()) {
+                    continue;
                 }
 
-                if(argType.type != thingy->paramTypes[i]) {
-                    return TypeInfo::error(std::format("Type mismatch in argument {} of function '{}'. Expected {}, got {}", 
-                        i, call->ident.value.value(), getTypeName(thingy->paramTypes[i]), getTypeName(argType.type)));
+                const VarType paramType = m_Result.types[params[i]];
+                if(argType.value() != paramType) {
+                    error(std::format("Type mismatch in argument {} of function '{}'. Expected {}, got {}", 
+                        i, name, getTypeName(paramType), getTypeName(argType.value())));
                 }
             }
 
-            return TypeInfo::valid(thingy->returnType);
+            return symbol.type;
         }
-    };
-    
-    TermTypeVisitor visitor{*this};
-    return std::visit(visitor, term->var);
+        default:
+            error("Expected an expression");
+            return {};
+    }
 }
 
-TypeInfo TypeChecker::checkBinExpr(const NodeBinExpr* binExpr) {
-    TypeInfo leftType = checkExpr(binExpr->left);
-    TypeInfo rightType = checkExpr(binExpr->right);
-    
-    if (!leftType.isValid)  {
-        return leftType;
-    }
-    
-    if (!rightType.isValid) {
-        return rightType;
+std::optional<VarType> TypeChecker::checkBinExpr(const NodeIndex binExpr) {
+    const std::optional<VarType> left = checkExpr(m_Ast.lhs(binExpr));
+    const std::optional<VarType> right = checkExpr(m_Ast.rhs(binExpr));
+    if (!left.has_value() || !right.has_value()) {
+        return {};
     }
-    
-    
-    switch (binExpr->op) {
+
+    const VarType leftType = left.value();
+    const VarType rightType = right.value();
+    switch (m_Ast.binOp(binExpr)) {
         case BinOp::Add:
-            if (leftType.type == VarType::String || rightType.type == VarType::String) {
-                return TypeInfo::valid(VarType::String);
+            if (leftType == VarType::String || rightType == VarType::String) {
+                return VarType::String;
             }
-            if (leftType.type == VarType::Number && rightType.type == VarType::Number) {
-                return TypeInfo::valid(VarType::Number);
+            if (leftType == VarType::Number && rightType == VarType::Number) {
+                return VarType::Number;
             }
-            return TypeInfo::error(std::format("Invalid types for addition: cannot add {} and {}", 
-                getTypeName(leftType.type), getTypeName(rightType.type)));
+            error(std::format("Invalid types for addition: cannot add {} and {}", 
+                getTypeName(leftType), getTypeName(rightType)));
+            return {};
             
         case BinOp::Mul:
-            if ((leftType.type == VarType::String && rightType.type == VarType::Number) ||
-                (leftType.type == VarType::Number && rightType.type == VarType::String)) {
-                return TypeInfo::valid(VarType::String);
+            if ((leftType == VarType::String && rightType == VarType::Number) ||
+                (leftType == VarType::Number && rightType == VarType::String)) {
+                return VarType::String;
             }
-            if (leftType.type == VarType::Number && rightType.type == VarType::Number) {
-                return TypeInfo::valid(VarType::Number);
+            if (leftType == VarType::Number && rightType == VarType::Number) {
+                return VarType::Number;
             }
-            return TypeInfo::error(std::format("Invalid types for multiplication: cannot multiply {} and {}", 
-                getTypeName(leftType.type), getTypeName(rightType.type)));
+            error(std::format("Invalid types for multiplication: cannot multiply {} and {}", 
+                getTypeName(leftType), getTypeName(rightType)));
+            return {};
             
         case BinOp::Sub:
         case BinOp::Div:
-            if (leftType.type != VarType::Number || rightType.type != VarType::Number) {
-                return TypeInfo::error("Arithmetic operations require numbers");
+            if (leftType != VarType::Number || rightType != VarType::Number) {
+                error("Arithmetic operations require numbers");
+                return {};
             }
-            return TypeInfo::valid(VarType::Number);
+            return VarType::Number;
             
         case BinOp::Eq:
         case BinOp::Neq:
-            return TypeInfo::valid(VarType::Bool);
+            return VarType::Bool;
             
         case BinOp::Lt:
         case BinOp::Le:
         case BinOp::Gt:
         case BinOp::Ge:
-            if (leftType.type == VarType::String || rightType.type == VarType::String) {
-                return TypeInfo::error("Comparison operations not supported on strings");
+            if (leftType == VarType::String || rightType == VarType::String) {
+                error("Comparison operations not supported on strings");
+                return {};
             }
-            return TypeInfo::valid(VarType::Bool);
+            return VarType::Bool;
             
         case BinOp::And:
         case BinOp::Or:
-            return TypeInfo::valid(VarType::Bool);
+            return VarType::Bool;
             
         case BinOp::Band:
         case BinOp::Bor:
         case BinOp::Xor:
-            if (leftType.type == VarType::String || rightType.type == VarType::String) {
-                return TypeInfo::error("Bitwise operations not supported on strings");
+            if (leftType == VarType::String || rightType == VarType::String) {
+                error("Bitwise operations not supported on strings");
+                return {};
             }
-            return TypeInfo::valid(VarType::Number);
+            return VarType::Number;
             
         default:
-            return TypeInfo::error("Unknown binary operator");
+            error("Unknown binary operator");
+            return {};
+    }
+}
+
+void TypeChecker::checkScope(const NodeIndex scope) {
+    m_Symbols.enterScope();
+    for (const NodeIndex stmt : m_Ast.list(scope)) {
+        checkStmt(stmt);
+    }
+    m_Symbols.leaveScope();
+}
+
+void TypeChecker::checkMaybePred(const NodeIndex pred) {
+    if (m_Ast.kind(pred) == NodeKind::Nah) {
+        checkScope(m_Ast.lhs(pred));
+        return;
+    }
+
+    const Ast::Branch but = m_Ast.branch(pred);
+    checkExpr(but.cond);
+    checkScope(but.scope);
+    if (but.pred != NoNode) {
+        checkMaybePred(but.pred);
+    }
+}
+
+void TypeChecker::checkThingy(const NodeIndex stmtThingy) {
+    const Ast::Proto proto = m_Ast.proto(stmtThingy);
+    // declared before the body so thingies can call themselves
+    declare(stmtThingy, SymbolKind::Thingy, tokenTypeToVarType(proto.returnType));
+
+    const NodeIndex outer = m_Owner;
+    m_Owner = stmtThingy;
+    m_Symbols.enterScope();
+    for (const NodeIndex param : proto.params) {
+        declare(param, SymbolKind::Param, tokenTypeToVarType(m_Ast.typeToken(param)));
     }
+    checkScope(proto.scope);
+    m_Symbols.leaveScope();
+    m_Owner = outer;
 }
 
-const Var* TypeChecker::lookupVar(const std::string& name) {
-    for (auto it = m_Scopes.rbegin(); it != m_Scopes.rend(); it++) {
-        auto found = it->vars.find(name);
-        if (found != it->vars.end()) {
-            return &found->second;
+void TypeChecker::checkStmt(const NodeIndex stmt) {
+    switch (m_Ast.kind(stmt)) {
+        case NodeKind::Bye: {
+            const std::optional<VarType> type = checkExpr(m_Ast.lhs(stmt));
+            if (type.has_value() && type.value() != VarType::Number) {
+                error(std::format("bye() requires a number argument, got {}", getTypeName(type.value())));
+            }
+            break;
+        }
+
+        case NodeKind::Gimme: {
+            const VarType declaredType = tokenTypeToVarType(m_Ast.typeToken(stmt));
+            // the initializer cannot see the variable it initializes
+            const std::optional<VarType> type = checkExpr(m_Ast.lhs(stmt));
+            if (type.has_value() && type.value() != declaredType) {
+                error(std::format("Type mismatch in variable declaration '{}'. Expected {}, got {}", 
+                    m_Interner.name(m_Ast.name(stmt)), getTypeName(declaredType), getTypeName(type.value())));
+            }
+            declare(stmt, SymbolKind::Var, declaredType);
+            break;
+        }
+
+        case NodeKind::Assignment: {
+            const NameId name = m_Ast.name(stmt);
+            const SymbolId var = resolveVar(name);
+            m_Result.symbols[stmt] = var;
+
+            const std::optional<VarType> type = checkExpr(m_Ast.lhs(stmt));
+            if (var != NoSymbol && type.has_value() && type.value() != m_Result.symbolTable[var].type) {
+                error(std::format("Type mismatch in assignment to '{}'. Expected {}, got {}", 
+                    m_Interner.name(name), getTypeName(m_Result.symbolTable[var].type), getTypeName(type.value())));
+            }
+            break;
+        }
+
+        case NodeKind::Scope:
+            checkScope(stmt);
+            break;
+
+        case NodeKind::Maybe: {
+            const Ast::Branch maybe = m_Ast.branch(stmt);
+            checkExpr(maybe.cond);
+            checkScope(maybe.scope);
+            if (maybe.pred != NoNode) {
+                checkMaybePred(maybe.pred);
+            }
+            break;
+        }
+
+        case NodeKind::Yell: {
+            const std::optional<VarType> type = checkExpr(m_Ast.lhs(stmt));
+            if (type.has_value() && type.value() != VarType::String) {
+                error(std::format("yell() requires a string argument, got {}", getTypeName(type.value())));
+            }
+            break;
+        }
+
+        case NodeKind::Thingy:
+            checkThingy(stmt);
+            break;
+
+        case NodeKind::Gimmeback:
+            checkExpr(m_Ast.lhs(stmt));
+            break;
+
+        case NodeKind::Four: {
+            const Ast::Loop four = m_Ast.loop(stmt);
+            m_Symbols.enterScope();
+            declare(stmt, SymbolKind::Var, VarType::Number);
+            checkExpr(four.start);
+            checkExpr(four.end);
+            checkScope(four.scope);
+            m_Symbols.leaveScope();
+            break;
         }
+
+        case NodeKind::Why:
+            checkExpr(m_Ast.lhs(stmt));
+            checkScope(m_Ast.rhs(stmt));
+            break;
+
+        default:
+            error("Expected a statement");
     }
-    return nullptr;
 }
 
-const Thingy* TypeChecker::lookupThingy(const std::string& name) {
-     for (auto it = m_Scopes.rbegin(); it != m_Scopes.rend(); ++it) {
-        auto found = it->functions.find(name);
-        if (found != it->functions.end()) {
-            return &found->second;
+SymbolId TypeChecker::declare(const NodeIndex decl, const SymbolKind kind, const VarType type) {
+    const NameId name = m_Ast.name(decl);
+    const auto id = static_cast<SymbolId>(m_Result.symbolTable.size());
+    const auto ns = (kind == SymbolKind::Thingy) ? SymbolTable::Namespace::Thingy : SymbolTable::Namespace::Var;
+    // a redeclaration still binds, so later uses resolve to it instead of erroring again
+    if (!m_Symbols.declare(ns, name, id)) {
+        switch (kind) {
+            case SymbolKind::Var:
+                error(std::format("Identifier already declared in this scope: {}", m_Interner.name(name)));
+                break;
+            case SymbolKind::Param:
+                error(std::format("Parameter already declared: {}", m_Interner.name(name)));
+                break;
+            case SymbolKind::Thingy:
+                error(std::format("Function already declared in this scope: {}", m_Interner.name(name)));
+                break;
         }
     }
-    return nullptr;
-}
\ No newline at end of file
+
+    m_Result.symbolTable.push_back(Symbol{ .name = name, .kind = kind, .type = type, .decl = decl, .owner = m_Owner });
+    m_Result.symbols[decl] = id;
+    m_Result.types[decl] = type;
+    return id;
+}
+
+SymbolId TypeChecker::resolveVar(const NameId name) {
+    const SymbolId var = m_Symbols.lookup(SymbolTable::Namespace::Var, name);
+    if (var == NoSymbol) {
+        error(std::format("Undeclared identifier: {}", m_Interner.name(name)));
+        return NoSymbol;
+    }
+    // variables live in their thingy's frame, a nested thingy has no way to reach them
+    if (m_Result.symbolTable[var].owner != m_Owner) {
+        error(std::format("Thingy '{}' cannot use '{}' from an enclosing scope", m_Interner.name(m_Ast.name(m_Owner)), m_Interner.name(name)));
+        return NoSymbol;
+    }
+    return var;
+}
+
+std::optional<VarType> TypeChecker::annotate(const NodeIndex node, const std::optional<VarType> type) {
+    if (type.has_value()) {
+        m_Result.types[node] = type.value();
+    }
+    return type;
+}
+
+void TypeChecker::error(std::string msg) {
+    m_Errors.push_back(std::move(msg));
+}